@@ -11,7 +11,7 @@
 // note: in microplugins, all returning values
 // and arguments of tasks are std::any type;
 // after running a task it returns std::shared_future<std::any> type
-// because the tasks will launched in async mode, see std::async
+// because the tasks will launched in async mode, see micro::thread_pool
 
 
 [[maybe_unused]] static std::any service(std::any a1) {
@@ -29,12 +29,10 @@
     if (other_plugin) {
       // do things with newly loaded plugin from the manager (or do any calculations)
       if (other_plugin->has<0>("help")) {
-        std::shared_future<std::any> result = other_plugin->run<0>("help");
-        // we can pass the result as argument into any function ...
-        result.wait(); // needs wait for calculation the result
-        if (result.valid() && result.get().has_value() && result.get().type() == typeid(std::string)) {
-          std::clog << std::any_cast<std::string>(result.get()) << std::endl;
-        }
+        // continuation is called when the result is ready, so the service does not wait for it
+        other_plugin->run<0>("help").then([](const std::any& help) {
+          if (help.type() == typeid(std::string)) { std::clog << std::any_cast<std::string>(help) << std::endl; }
+        });
       }
     }
 
@@ -0,0 +1,591 @@
+#ifndef BENCHMARK_CXX
+#define BENCHMARK_CXX
+
+#include "plugins.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <shared_mutex>
+#include <vector>
+
+using namespace micro::literals;
+
+// note: the benchmark measures overhead of the framework itself,
+// so all tasks here are trivial functions
+
+
+static std::any sum2(std::any a1, std::any a2) {
+  return std::any_cast<int>(a1) + std::any_cast<int>(a2);
+}
+
+
+// storage with tasks for benchmarks
+class bench_storage final : public micro::storage<> {
+public:
+
+  bench_storage():micro::storage<>(micro::make_version(1,0), "bench_storage") {
+    subscribe<2>("sum2", sum2);
+  }
+
+};
+
+
+// prints one line of report
+static void report(const std::string& what, double calls_per_sec, double p50_us, double p99_us) {
+  std::cout << std::left << std::setw(48) << what << std::right << std::fixed << std::setprecision(0)
+            << std::setw(12) << calls_per_sec << " calls/sec"
+            << std::setprecision(2)
+            << std::setw(10) << p50_us << " us p50"
+            << std::setw(10) << p99_us << " us p99" << std::endl;
+}
+
+
+// prints one line of report without latencies
+static void report(const std::string& what, double calls_per_sec) {
+  std::cout << std::left << std::setw(48) << what << std::right << std::fixed << std::setprecision(0)
+            << std::setw(12) << calls_per_sec << " calls/sec" << std::endl;
+}
+
+
+// returns given percentile from measured latencies (in nanoseconds) as microseconds
+static double percentile(std::vector<std::time_t>& v, double p) {
+  if (v.empty()) return 0;
+  std::size_t i = std::min(v.size() - 1, std::size_t(p * double(v.size())));
+  std::nth_element(v.begin(), v.begin() + i, v.end());
+  return double(v[i]) / 1000.0;
+}
+
+
+// throughput: `n' calls in flight at once, then waits all of them;
+// latency: one call at a time from call to ready result
+static void bench_executor(std::shared_ptr<micro::iexecutor> e, const std::string& what, std::size_t n) {
+  micro::task<std::any,std::any> t("sum2", sum2);
+  t.executor(e);
+
+  std::vector<micro::future<std::any>> results(n);
+  micro::stopwatch timer;
+  for (std::size_t i = 0; i < n; ++i) { results[i] = t.run(int(i), 1); }
+  for (auto& r : results) { r.wait(); }
+  double calls_per_sec = double(n) * 1e9 / double(std::max<std::time_t>(1, timer.elapsed<micro::nanoseconds>()));
+
+  std::vector<std::time_t> latencies(n);
+  for (std::size_t i = 0; i < n; ++i) {
+    timer.restart();
+    t.run(int(i), 1).wait();
+    latencies[i] = timer.elapsed<micro::nanoseconds>();
+  }
+
+  report(what, calls_per_sec, percentile(latencies, 0.5), percentile(latencies, 0.99));
+}
+
+
+// dispatch cost only: tasks are executed inline by the calling thread
+template<typename F>
+static void bench_dispatch(const std::string& what, std::size_t n, F&& call) {
+  std::vector<std::time_t> latencies(n);
+  micro::stopwatch total, timer;
+  for (std::size_t i = 0; i < n; ++i) {
+    timer.restart();
+    call(int(i)).wait();
+    latencies[i] = timer.elapsed<micro::nanoseconds>();
+  }
+  double calls_per_sec = double(n) * 1e9 / double(std::max<std::time_t>(1, total.elapsed<micro::nanoseconds>()));
+  report(what, calls_per_sec, percentile(latencies, 0.5), percentile(latencies, 0.99));
+}
+
+
+// fan-out of `width' calls and fan-in of their results: by waiting of each result against continuations
+static void bench_fan_in(std::size_t n, std::size_t width) {
+  bench_storage s;
+  std::vector<micro::future<std::any>> calls(width);
+  micro::stopwatch timer;
+  for (std::size_t i = 0; i < n; ++i) {
+    int sum = 0;
+    for (std::size_t j = 0; j < width; ++j) { calls[j] = s.run<2>("sum2"_task, int(j), 1); }
+    for (auto& c : calls) { sum += std::any_cast<int>(c.get()); }
+    if (sum <= 0) { std::abort(); }
+  }
+  report("fan-in " + std::to_string(width) + " calls, wait each", double(n * width) * 1e9 / double(std::max<std::time_t>(1, timer.elapsed<micro::nanoseconds>())));
+
+  std::vector<micro::future<int>> sums(n);
+  timer.restart();
+  for (std::size_t i = 0; i < n; ++i) {
+    for (std::size_t j = 0; j < width; ++j) { calls[j] = s.run<2>("sum2"_task, int(j), 1); }
+    sums[i] = micro::when_all(calls).then([](const std::vector<micro::future<std::any>>& rs) {
+      int sum = 0;
+      for (const auto& r : rs) { sum += std::any_cast<int>(r.get()); }
+      return sum;
+    });
+  }
+  for (auto& r : sums) { if (r.get() <= 0) { std::abort(); } }
+  report("fan-in " + std::to_string(width) + " calls, when_all + then", double(n * width) * 1e9 / double(std::max<std::time_t>(1, timer.elapsed<micro::nanoseconds>())));
+}
+
+
+// shared state only: promise is set and future is read by the same thread
+static void bench_future(std::size_t n) {
+  bench_dispatch("std::promise + std::shared_future", n, [](int i) {
+    std::promise<std::any> p;
+    std::shared_future<std::any> f = p.get_future().share();
+    p.set_value(i);
+    return f;
+  });
+  bench_dispatch("micro::promise + micro::future", n, [](int i) {
+    micro::promise<std::any> p;
+    micro::future<std::any> f = p.get_future();
+    p.set_value(i);
+    return f;
+  });
+  bench_dispatch("micro::future -> std::shared_future", n, [](int i) {
+    micro::promise<std::any> p;
+    std::shared_future<std::any> f = p.get_future();
+    p.set_value(i);
+    return f;
+  });
+}
+
+
+// `nthreads' threads calls `f' for `n' times each, prints total calls per second
+template<typename F>
+static void bench_threads(const std::string& what, std::size_t nthreads, std::size_t n, F&& f) {
+  std::vector<std::thread> threads;
+  std::atomic<bool> start(false);
+  for (std::size_t i = 0; i < nthreads; ++i) {
+    threads.emplace_back([&start, &f, n]() {
+      while (!start) { std::this_thread::yield(); }
+      for (std::size_t j = 0; j < n; ++j) { f(); }
+    });
+  }
+  micro::stopwatch timer;
+  start = true;
+  for (auto& t : threads) { t.join(); }
+  report(what + ", threads: " + std::to_string(nthreads), double(n * nthreads) * 1e9 / double(std::max<std::time_t>(1, timer.elapsed<micro::nanoseconds>())));
+}
+
+
+static void bench_bind(std::size_t n) {
+  bench_storage s;
+  s.executor(std::make_shared<micro::inline_executor>());
+  auto sum2_handle = s.bind<2>("sum2");
+  bench_dispatch("storage::run<2>(\"sum2\"), inline", n, [&s](int i) { return s.run<2>("sum2", i, 1); });
+  bench_dispatch("storage::run<2>(\"sum2\"_task), inline", n, [&s](int i) { return s.run<2>("sum2"_task, i, 1); });
+  bench_dispatch("storage::bind<2>(\"sum2\"), inline", n, [&sum2_handle](int i) { return sum2_handle(i, 1); });
+  // the same handle is called by concurrent threads
+  for (std::size_t nthreads = 1; nthreads <= 16; nthreads *= 4) {
+    bench_threads("storage::run<2>(\"sum2\"_task), inline", nthreads, n, [&s]() { s.run<2>("sum2"_task, 1, 1); });
+    bench_threads("storage::bind<2>(\"sum2\"), inline", nthreads, n, [&sum2_handle]() { sum2_handle(1, 1); });
+  }
+}
+
+
+// storage with the same tasks as untyped (std::any) and typed ones
+class bench_typed_storage final : public micro::storage<> {
+public:
+
+  bench_typed_storage():micro::storage<>(micro::make_version(1,0), "bench_typed_storage") {
+    subscribe<2>("sum2", sum2);
+    subscribe<int(int,int)>("sum2_typed", [](int a, int b) { return a + b; });
+    subscribe<1>("echo_string", [](std::any a)->std::any { return std::any_cast<std::string>(std::move(a)); });
+    subscribe<std::string(std::string)>("echo_string_typed", [](std::string a) { return a; });
+    subscribe<1>("echo_vector", [](std::any a)->std::any { return std::any_cast<std::vector<double>>(std::move(a)); });
+    subscribe<std::vector<double>(std::vector<double>)>("echo_vector_typed", [](std::vector<double> a) { return a; });
+  }
+
+};
+
+
+// boxing cost: the same payloads through std::any tasks and through typed tasks, executed inline
+static void bench_typed(std::size_t n) {
+  bench_typed_storage s;
+  s.executor(std::make_shared<micro::inline_executor>());
+  const std::string str(64, 'x');
+  const std::vector<double> vec(64, 1.5);
+  bench_dispatch("int: run<2>, std::any", n, [&s](int i) { return s.run<2>("sum2"_task, i, 1); });
+  bench_dispatch("int: run<int(int,int)>", n, [&s](int i) { return s.run<int(int,int)>("sum2_typed"_task, i, 1); });
+  bench_dispatch("std::string: run<1>, std::any", n, [&s, &str](int) { return s.run<1>("echo_string"_task, str); });
+  bench_dispatch("std::string: run<std::string(std::string)>", n, [&s, &str](int) { return s.run<std::string(std::string)>("echo_string_typed"_task, str); });
+  bench_dispatch("vector<double>: run<1>, std::any", n, [&s, &vec](int) { return s.run<1>("echo_vector"_task, vec); });
+  bench_dispatch("vector<double>: run<vector(vector)>", n, [&s, &vec](int) { return s.run<std::vector<double>(std::vector<double>)>("echo_vector_typed"_task, vec); });
+}
+
+
+// registry of tasks as it was before micro::rcu, for comparison
+class shared_mutex_registry final {
+private:
+
+  mutable std::shared_mutex mtx_;
+  std::map<std::string, std::shared_ptr<micro::task<std::any,std::any>>> tasks_;
+
+public:
+
+  shared_mutex_registry():mtx_(),tasks_() { tasks_["sum2"] = std::make_shared<micro::task<std::any,std::any>>("sum2", sum2); }
+
+  bool has(const std::string& nm) const {
+    std::shared_lock<std::shared_mutex> lock(mtx_);
+    return tasks_.find(nm) != tasks_.end();
+  }
+
+  // task is shared out of lock and called after it
+  std::shared_ptr<micro::task<std::any,std::any>> get(const std::string& nm) const {
+    std::shared_lock<std::shared_mutex> lock(mtx_);
+    auto it = tasks_.find(nm);
+    return (it != tasks_.end()) ? it->second : nullptr;
+  }
+
+  micro::future<std::any> run(const std::string& nm, micro::iexecutor* e, int a1, int a2) const {
+    auto t = get(nm);
+    return t ? t->run_by(e, a1, a2) : micro::future<std::any>();
+  }
+
+  std::any call(const std::string& nm, int a1, int a2) const {
+    auto t = get(nm);
+    return t ? t->call(a1, a2) : std::any();
+  }
+
+};
+
+
+// storage with task which counts its calls
+class bench_counter_storage final : public micro::storage<> {
+public:
+
+  std::atomic<std::size_t> calls{0};
+
+  bench_counter_storage():micro::storage<>(micro::make_version(1,0), "bench_counter_storage") {
+    subscribe<2>("sum2", sum2);
+    subscribe<1>("count", [this](std::any)->std::any { return ++calls; });
+    // expensive lookup of about 50 us
+    subscribe<1>("lookup", [this](std::any key)->std::any {
+      ++calls;
+      micro::stopwatch w;
+      while (w.elapsed<micro::microseconds>() < 50) {}
+      return std::any_cast<std::string>(key).size();
+    });
+  }
+
+};
+
+
+// call modes: run (future), post (no future), call (calling thread, no executor)
+static void bench_modes(std::size_t n) {
+  bench_counter_storage s;
+  bench_threads("storage::run<2>(...).get(), thread_pool", 1, n, [&s]() { s.run<2>("sum2"_task, 1, 1).get(); });
+  bench_threads("storage::run<1>(...), thread_pool", 1, n, [&s]() { s.run<1>("count"_task, 1); });
+  while (s.calls < n) { std::this_thread::yield(); }
+  s.calls = 0;
+  bench_threads("storage::post<1>(...), thread_pool", 1, n, [&s]() { s.post<1>("count"_task, 1); });
+  while (s.calls < n) { std::this_thread::yield(); }
+  s.executor(std::make_shared<micro::inline_executor>());
+  bench_threads("storage::run<2>(...).get(), inline", 1, n, [&s]() { s.run<2>("sum2"_task, 1, 1).get(); });
+  bench_threads("storage::post<2>(...), inline", 1, n, [&s]() { s.post<2>("sum2"_task, 1, 1); });
+  bench_threads("storage::call<2>(...)", 1, n, [&s]() { s.call<2>("sum2"_task, 1, 1); });
+}
+
+
+// adaptive dispatch: short task goes inline, long one (about 50 us) stays on thread_pool
+static void bench_adaptive(std::size_t n) {
+  bench_counter_storage s;
+  auto spin = [](std::any)->std::any { micro::stopwatch w; while (w.elapsed<micro::microseconds>() < 50) {} return 0; };
+  micro::task<std::any> long_task(spin);
+  bench_threads("sum2 run().get(), thread_pool", 1, n, [&s]() { s.run<2>("sum2"_task, 1, 1).get(); });
+  s.adaptive(std::make_shared<micro::adaptive_policy>(micro::microseconds(2), micro::microseconds(20)));
+  bench_threads("sum2 run().get(), adaptive", 1, n, [&s]() { s.run<2>("sum2"_task, 1, 1).get(); });
+  auto a = s.adaptive();
+  auto c = a->counters();
+  std::cout << "  decisions: " << c.inlined << " inline, " << c.offloaded << " offloaded" << std::endl;
+  a->reset_counters();
+  std::size_t m = std::max<std::size_t>(1, n / 1000);
+  bench_threads("50 us task run().get(), adaptive", 1, m, [&long_task, &a]() { long_task.run_adaptive_by(nullptr, a.get(), 1).get(); });
+  c = a->counters();
+  std::cout << "  decisions: " << c.inlined << " inline, " << c.offloaded << " offloaded, estimate "
+            << long_task.stats().estimate() / 1000 << " us" << std::endl;
+}
+
+
+// `n' records through task sum2: call per record against one batch, rates are records per second
+static void bench_batch(std::size_t n) {
+  bench_storage s;
+  std::vector<std::tuple<int,int>> records(n);
+  for (std::size_t i = 0; i < n; ++i) { records[i] = {int(i), 1}; }
+  micro::stopwatch timer;
+  std::vector<micro::future<std::any>> fs;
+  fs.reserve(n);
+  for (const auto& r : records) { fs.push_back(s.run<2>("sum2"_task, std::get<0>(r), std::get<1>(r))); }
+  micro::when_all(std::move(fs)).wait();
+  report("run<2> per record + when_all, records: " + std::to_string(n), double(n) * 1e9 / double(std::max<std::time_t>(1, timer.elapsed<micro::nanoseconds>())));
+  timer.restart();
+  s.run_batch<2>("sum2"_task, records).wait();
+  report("run_batch<2>, records: " + std::to_string(n), double(n) * 1e9 / double(std::max<std::time_t>(1, timer.elapsed<micro::nanoseconds>())));
+}
+
+
+// storage with the same addition as scalar untyped, scalar typed and batch handler
+class bench_batch_storage final : public micro::storage<> {
+public:
+
+  bench_batch_storage():micro::storage<>(micro::make_version(1,0), "bench_batch_storage") {
+    subscribe<2>("add", [](std::any a, std::any b)->std::any { return std::any_cast<double>(a) + std::any_cast<double>(b); });
+    subscribe<double(double,double)>("add_typed", [](double a, double b) { return a + b; });
+    subscribe_batch<double(double,double)>("add_batch", [](const double* a, const double* b, double* r, std::size_t n) {
+      for (std::size_t i = 0; i < n; ++i) { r[i] = a[i] + b[i]; } // vectorized by compiler
+    });
+    subscribe<1>("transform", [](std::any x)->std::any { return std::sqrt(std::any_cast<double>(x)); });
+    subscribe<double(double)>("transform_typed", [](double x) { return std::sqrt(x); });
+  }
+
+};
+
+
+// batch handler against scalar tasks for the same batch, rates are elements per second
+static void bench_batch_handler(std::size_t n) {
+  bench_batch_storage s;
+  std::vector<std::tuple<double,double>> batch(n);
+  for (std::size_t i = 0; i < n; ++i) { batch[i] = {double(i), 0.5}; }
+  auto measure = [n](const std::string& what, auto&& f) {
+    micro::stopwatch timer;
+    f();
+    report(what + ", elements: " + std::to_string(n), double(n) * 1e9 / double(std::max<std::time_t>(1, timer.elapsed<micro::nanoseconds>())));
+  };
+  measure("run_batch<2>, scalar std::any task", [&]() { s.run_batch<2>("add"_task, batch).wait(); });
+  measure("run_batch<double(double,double)>, typed task", [&]() { s.run_batch<double(double,double)>("add_typed"_task, batch).wait(); });
+  measure("run_batch<double(double,double)>, batch handler", [&]() { s.run_batch<double(double,double)>("add_batch"_task, batch).wait(); });
+}
+
+
+// `n' elements through task transform: future per element against parallel_map, rates are elements per second
+static void bench_parallel_map(std::size_t n) {
+  bench_batch_storage s;
+  std::vector<double> xs(n);
+  for (std::size_t i = 0; i < n; ++i) { xs[i] = double(i); }
+  std::vector<std::any> boxed(std::begin(xs), std::end(xs));
+  auto measure = [n](const std::string& what, auto&& f) {
+    micro::stopwatch timer;
+    f();
+    report(what + ", elements: " + std::to_string(n), double(n) * 1e9 / double(std::max<std::time_t>(1, timer.elapsed<micro::nanoseconds>())));
+  };
+  if (n <= 100000) { // future per element does not fit into memory for large ranges
+    measure("run<1> per element + when_all", [&]() {
+      std::vector<micro::future<std::any>> fs;
+      fs.reserve(n);
+      for (const auto& x : boxed) { fs.push_back(s.run<1>("transform"_task, x)); }
+      micro::when_all(std::move(fs)).wait();
+    });
+  }
+  measure("parallel_map<1>", [&]() { s.parallel_map<1>("transform"_task, boxed).wait(); });
+  measure("parallel_map<1>, grain 1024", [&]() { s.parallel_map<1>("transform"_task, boxed, 1024).wait(); });
+  measure("parallel_map<double(double)>", [&]() { s.parallel_map<double(double)>("transform_typed"_task, xs).wait(); });
+}
+
+
+// single calls of task with batch handler from `nthreads' threads: each call as job of thread_pool against micro-batching
+static void bench_micro_batch(std::size_t nthreads, std::size_t n) {
+  bench_batch_storage s;
+  auto measure = [&s, nthreads, n](const std::string& what) {
+    std::vector<std::thread> threads;
+    micro::stopwatch timer;
+    for (std::size_t i = 0; i < nthreads; ++i) {
+      threads.emplace_back([&s, n]() {
+        std::vector<micro::future<double>> results;
+        results.reserve(n);
+        for (std::size_t j = 0; j < n; ++j) { results.push_back(s.run<double(double,double)>("add_batch"_task, double(j), 0.5)); }
+        for (auto& r : results) { r.wait(); }
+      });
+    }
+    for (auto& t : threads) { t.join(); }
+    report(what + ", threads: " + std::to_string(nthreads), double(n * nthreads) * 1e9 / double(std::max<std::time_t>(1, timer.elapsed<micro::nanoseconds>())));
+  };
+  measure("storage::run<double(double,double)>, batch handler per call");
+  s.micro_batch<double(double,double)>("add_batch"_task, std::chrono::microseconds(100), 1024);
+  measure("storage::run<double(double,double)>, micro-batching 100us/1024");
+}
+
+
+// expensive lookup (about 50 us) with few distinct keys from `nthreads' threads: each call executed against single-flight
+static void bench_single_flight(std::size_t nthreads, std::size_t n) {
+  bench_counter_storage s;
+  const std::vector<std::string> keys = {"alpha", "beta", "gamma", "delta"};
+  auto f = [&s, &keys, i = std::size_t(0)]() mutable { s.run<1>("lookup"_task, keys[i++ % std::size(keys)]).get(); };
+  bench_threads("lookup run<1>(...).get(), each call executed", nthreads, n, f);
+  std::cout << "  executions: " << s.calls << std::endl;
+  s.calls = 0;
+  s.single_flight<1>("lookup"_task);
+  bench_threads("lookup run<1>(...).get(), single-flight", nthreads, n, f);
+  std::cout << "  executions: " << s.calls << std::endl;
+}
+
+
+// expensive lookup (about 50 us) with few distinct keys: each call executed against cache of results
+static void bench_cache(std::size_t n) {
+  bench_counter_storage s;
+  const std::vector<std::string> keys = {"alpha", "beta", "gamma", "delta"};
+  auto f = [&s, &keys, i = std::size_t(0)]() mutable { s.run<1>("lookup"_task, keys[i++ % std::size(keys)]).get(); };
+  bench_threads("lookup run<1>(...).get(), each call executed", 1, n / 100, f);
+  s.cache<1>("lookup"_task, 1 << 20, std::chrono::seconds(60));
+  bench_threads("lookup run<1>(...).get(), cache of results", 1, n, f);
+  auto c = s.cache<1>("lookup"_task)->stats();
+  std::cout << "  hits: " << c.hits << ", misses: " << c.misses << ", entries: " << c.entries << ", bytes: " << c.bytes << std::endl;
+  bench_threads("lookup call<1>(...), cache of results", 1, n, [&s, &keys, i = std::size_t(0)]() mutable { s.call<1>("lookup"_task, keys[i++ % std::size(keys)]); });
+}
+
+
+// probes of absent plugin (like bad_plugin1 does): search of directories each time against negative lookup
+static void bench_missing_plugin(std::size_t n) {
+  std::shared_ptr<micro::plugins<>> k = micro::plugins<>::get();
+  std::streambuf* log = std::clog.rdbuf(nullptr); // status of each loading is not printed
+  k->run();
+  k->negative_ttl(std::chrono::seconds(0));
+  bench_threads("get_plugin(\"other_plugin\"), search each time", 1, n / 1000, [&k]() { if (k->get_plugin("other_plugin")) { std::abort(); } });
+  k->negative_ttl(std::chrono::seconds(5));
+  bench_threads("get_plugin(\"other_plugin\"), negative lookup", 1, n, [&k]() { if (k->get_plugin("other_plugin")) { std::abort(); } });
+  k->stop();
+  std::clog.rdbuf(log);
+  std::clog.clear();
+}
+
+
+// unloading of plugin, which is released by its user 5 ms later, and stopping of kernel: polling of use_count against notification
+static void bench_unload(std::size_t n) {
+  std::shared_ptr<micro::plugins<>> k = micro::plugins<>::get();
+  std::streambuf* log = std::clog.rdbuf(nullptr);
+  k->run();
+  if (!k->get_plugin("plugin1")) {
+    std::cout << "  plugin1 is not found, unloading is not measured" << std::endl;
+  } else {
+    double unload = 0, stop = 0;
+    for (std::size_t i = 0; i < n; ++i) {
+      std::shared_ptr<micro::iplugin<>> p = k->get_plugin("plugin1");
+      p->run<2>("sum2"_task, 1, 2).wait();
+      std::thread user([p = std::move(p)]() mutable { micro::sleep<micro::milliseconds>(5); p = nullptr; });
+      micro::stopwatch timer;
+      k->unload_plugin("plugin1");
+      unload += double(timer.elapsed<micro::nanoseconds>()) / 1e6;
+      user.join();
+    }
+    std::cout << "unload_plugin(\"plugin1\"), released after 5 ms: " << std::fixed << std::setprecision(2) << unload / double(n) << " ms" << std::endl;
+    for (std::size_t i = 0; i < n; ++i) {
+      k->run();
+      k->get_plugin("plugin1");
+      micro::stopwatch timer;
+      k->stop();
+      stop += double(timer.elapsed<micro::nanoseconds>()) / 1e6;
+    }
+    std::cout << "plugins::stop(), one plugin loaded: " << std::fixed << std::setprecision(2) << stop / double(n) << " ms" << std::endl;
+  }
+  k->stop();
+  std::clog.rdbuf(log);
+  std::clog.clear();
+}
+
+
+// loading of library of plugin: search of directories by each loading against index built once at start of kernel
+static void bench_plugin_index(std::size_t n) {
+  micro::stopwatch timer;
+  micro::plugin_index index("microplugins");
+  index.refresh();
+  std::cout << "plugin_index::refresh(), libraries: " << index.size() << ", directories: " << std::size(index.dirs()) << ", "
+            << std::fixed << std::setprecision(2) << double(timer.elapsed<micro::nanoseconds>()) / 1e3 << " us" << std::endl;
+  if (index.find("plugin1").empty()) { std::cout << "  plugin1 is not found, loading is not measured" << std::endl; return; }
+  bench_threads("shared_library(\"plugin1\"), search", 1, n, []() { if (!micro::shared_library("plugin1", "microplugins").is_loaded()) { std::abort(); } });
+  bench_threads("shared_library::load_file, plugin_index::find", 1, n, [&index]() {
+    micro::shared_library dll;
+    for (const auto& e : index.find("plugin1")) { if (dll.load_file(e.filename)) { break; } }
+    if (!dll.is_loaded()) { std::abort(); }
+  });
+  micro::shared_library keep("plugin1", "microplugins"); // library stays loaded, dlopen only takes reference
+  bench_threads("shared_library(\"plugin1\"), search, library in memory", 1, n, []() { if (!micro::shared_library("plugin1", "microplugins").is_loaded()) { std::abort(); } });
+  bench_threads("load_file, plugin_index::find, library in memory", 1, n * 10, [&index]() {
+    micro::shared_library dll;
+    for (const auto& e : index.find("plugin1")) { if (dll.load_file(e.filename)) { break; } }
+    if (!dll.is_loaded()) { std::abort(); }
+  });
+}
+
+
+// lookup of task by name among `ntasks' tasks: std::map (as before) against hash table of micro::tasks
+static void bench_lookup(std::size_t ntasks, std::size_t n) {
+  std::map<std::string, std::shared_ptr<micro::task<std::any,std::any>>> m;
+  micro::tasks<std::any,std::any> ts;
+  std::vector<std::string> names;
+  for (std::size_t i = 0; i < ntasks; ++i) {
+    names.push_back("task_" + std::to_string(i * 7919));
+    m[names.back()] = std::make_shared<micro::task<std::any,std::any>>(names.back(), sum2);
+    ts.subscribe(names.back(), sum2);
+  }
+  const std::string suffix = ", tasks: " + std::to_string(ntasks);
+  bench_threads("std::map find" + suffix, 1, n, [&m, &names, i = std::size_t(0)]() mutable { if (m.find(names[i++ % std::size(names)]) == m.end()) { std::abort(); } });
+  bench_threads("tasks::has" + suffix, 1, n, [&ts, &names, i = std::size_t(0)]() mutable { if (!ts.has(names[i++ % std::size(names)])) { std::abort(); } });
+  ts.freeze();
+  bench_threads("tasks::has, frozen" + suffix, 1, n, [&ts, &names, i = std::size_t(0)]() mutable { if (!ts.has(names[i++ % std::size(names)])) { std::abort(); } });
+  std::vector<micro::task_key> keys;
+  for (const auto& nm : names) { keys.emplace_back(nm); }
+  bench_threads("tasks::has, frozen, task_key" + suffix, 1, n, [&ts, &keys, i = std::size_t(0)]() mutable { if (!ts.has(keys[i++ % std::size(keys)])) { std::abort(); } });
+}
+
+
+// readers of registry: lock-free snapshot of storage against std::shared_mutex, lookup only and lookup with call of task (inline)
+static void bench_contention(std::size_t n) {
+  bench_storage s;
+  shared_mutex_registry r;
+  auto e = std::make_shared<micro::inline_executor>();
+  s.executor(e);
+  const std::string nm = "sum2";
+  for (std::size_t nthreads = 1; nthreads <= 64; nthreads *= 2) {
+    bench_threads("std::shared_mutex has", nthreads, n, [&r, &nm]() { if (!r.has(nm)) { std::abort(); } });
+    bench_threads("storage::has<2>", nthreads, n, [&s, &nm]() { if (!s.has<2>(nm)) { std::abort(); } });
+    bench_threads("std::shared_mutex run", nthreads, n / 4, [&r, &nm, &e]() { if (!r.run(nm, e.get(), 1, 1).valid()) { std::abort(); } });
+    bench_threads("storage::run<2>", nthreads, n / 4, [&s, &nm]() { if (!s.run<2>(nm, 1, 1).valid()) { std::abort(); } });
+    bench_threads("std::shared_mutex call", nthreads, n / 4, [&r, &nm]() { if (!r.call(nm, 1, 1).has_value()) { std::abort(); } });
+    bench_threads("storage::call<2>", nthreads, n / 4, [&s, &nm]() { if (!s.call<2>(nm, 1, 1).has_value()) { std::abort(); } });
+  }
+}
+
+
+int main() {
+  std::cout << "workers in micro::thread_pool: " << micro::thread_pool::get()->size() << std::endl;
+
+  bench_executor(std::make_shared<micro::async_executor>(), "task::run, async_executor", 20000);
+  bench_executor(micro::thread_pool::get(), "task::run, thread_pool", 20000);
+  bench_executor(std::make_shared<micro::dedicated_thread>(), "task::run, dedicated_thread", 20000);
+  bench_executor(std::make_shared<micro::inline_executor>(), "task::run, inline_executor", 20000);
+
+  bench_future(200000);
+
+  bench_fan_in(20000, 8);
+
+  bench_bind(200000);
+
+  bench_typed(200000);
+
+  bench_modes(200000);
+
+  bench_adaptive(200000);
+
+  bench_batch(100000);
+
+  bench_batch_handler(1000000);
+
+  bench_micro_batch(8, 50000);
+
+  for (std::size_t n : {1000, 100000, 10000000}) { bench_parallel_map(n); }
+
+  bench_single_flight(8, 2000);
+
+  bench_cache(200000);
+
+  bench_plugin_index(2000);
+
+  bench_missing_plugin(200000);
+
+  bench_unload(5);
+
+  bench_contention(200000);
+
+  for (std::size_t ntasks : {4, 64, 1024}) { bench_lookup(ntasks, 1000000); }
+
+  return 0;
+}
+
+#endif // BENCHMARK_CXX
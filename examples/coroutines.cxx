@@ -0,0 +1,49 @@
+#ifndef COROUTINES_CXX
+#define COROUTINES_CXX
+
+#include "storage.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+// note: the example requires C++20 (coroutines), see coroutine.hpp
+
+
+// storage with coroutine task, which awaits other tasks without blocking of threads
+class coro_storage final : public micro::storage<> {
+public:
+
+  coro_storage():micro::storage<>(micro::make_version(1,0), "coro_storage") {
+    subscribe<2>("sum2", [](std::any a1, std::any a2)->std::any { return std::any_cast<int>(a1) + std::any_cast<int>(a2); });
+    subscribe<1>("quad", [this](std::any a1) -> micro::future<std::any> {
+      std::any x = co_await run<2>("sum2", a1, a1);
+      std::any y = co_await run<2>("sum2", x, x);
+      co_return y;
+    }, "returns 4 * a1, awaits task `sum2' two times");
+  }
+
+};
+
+
+int main() {
+  std::shared_ptr<coro_storage> storage = std::make_shared<coro_storage>();
+
+  const int n = 100000;
+  std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+
+  std::vector<micro::future<std::any>> results;
+  results.reserve(n);
+  for (int i = 0; i < n; ++i) { results.push_back(storage->run<1>("quad", i)); } // all calls are in flight together
+  micro::when_all(results).wait();
+
+  double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+  long long sum = 0;
+  for (const auto& r : results) { sum += std::any_cast<int>(r.get()); }
+  std::clog << "task `quad' returned sum: " << sum << " for " << n << " calls in " << secs << " sec" << std::endl;
+
+  return (sum == 2LL * n * (n - 1)) ? 0 : -1;
+}
+
+#endif // COROUTINES_CXX
@@ -9,28 +9,40 @@
 #include <csignal>
 
 
+using namespace micro::literals; // "name"_task - key of task with hash computed at compile time
+
+
 static std::any service(std::any a1) {
   int ret = 0;
   std::shared_ptr<micro::plugins<>> manager = std::any_cast<std::shared_ptr<micro::plugins<>>>(a1);
   // we can do loop while manager->is_run() - for real service ...
   if (manager->is_run()) {
+    // loading by own thread, kernel is not locked meanwhile
+    micro::future<std::shared_ptr<micro::iplugin<>>> loading = manager->get_plugin_async("bad_plugin1");
     std::shared_ptr<micro::iplugin<>> plugin1 = manager->get_plugin("plugin1");
-    std::shared_ptr<micro::iplugin<>> plugin2 = manager->get_plugin("bad_plugin1");
+    std::shared_ptr<micro::iplugin<>> plugin2 = loading.get();
     if (plugin1) {
 
-      std::shared_future<std::any> r1, r2, r3, r4;
+      micro::future<std::any> r1, r2, r3, r4;
+      micro::future<std::string> r5;
 
       r1 = plugin1->run<0>("test0");
-      r2 = plugin1->run<2>("sum2", 25, 25);
+      r2 = plugin1->run<2>("sum2"_task, 25, 25);
       r3 = plugin1->run<1>("method1", std::make_any<std::string>("method1 running ..."));
       r4 = plugin1->run<0>("lambda0");
+      r5 = plugin1->run<std::string(std::string,int)>("repeat", "ab", 3); // typed task, no std::any
 
-      r1.wait(); r2.wait(); r3.wait(), r4.wait();
+      micro::when_all(r1, r2, r3, r4, r5).wait(); // one waiting for all results
 
       std::clog << "task `plugin1::test0()' returned: " << std::any_cast<std::string>(r1.get()) << std::endl;
       std::clog << "task `plugin1::sum2(25, 25)' returned: " << std::any_cast<int>(r2.get()) << std::endl;
       std::clog << "task `plugin1::method1(...)' returned: " << std::any_cast<std::string>(r3.get()) << std::endl;
       std::clog << "task `plugin1::lambda0()' returned: " << std::any_cast<std::string>(r4.get()) << std::endl;
+      std::clog << "task `plugin1::repeat(\"ab\", 3)' returned: " << r5.get() << std::endl;
+
+      // the same task on all loaded plugins at once, results are reduced into one value
+      int total = manager->broadcast_reduce<2>("sum2"_task, 0, [](int acc, const std::any& r) { return acc + std::any_cast<int>(r); }, 1, 2).get();
+      std::clog << "task `sum2(1, 2)' of " << manager->count_plugins() << " loaded plugins returned in total: " << total << std::endl;
     } else {
       ret = -1;
     }
@@ -63,6 +75,8 @@ int main(/*int argc, char* argv[]*/) {
   // set max idle to 3 minutes - if no one task will not called in that period,
   // for each loaded plugin - it will be unloaded (0 - unlimited, default - 10)
   plugins->max_idle(3);
+  // new and changed libraries of plugins are noticed without polling of directories (Linux inotify)
+  plugins->watch();
   plugins->run(); // run thread for manage plugins
   while (plugins->is_run()) {
     micro::sleep<micro::milliseconds>(250);
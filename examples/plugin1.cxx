@@ -8,7 +8,7 @@
 // note: in microplugins, all returning values
 // and arguments of tasks are std::any type;
 // after running a task it returns std::shared_future<std::any> type
-// because the tasks will launched in async mode, see std::async
+// because the tasks will launched in async mode, see micro::thread_pool
 
 
 [[maybe_unused]] static std::any service(std::any a1) {
@@ -91,6 +91,10 @@ public:
     subscribe<1>("method1", std::bind(&plugin1::method1, this, std::placeholders::_1));
     subscribe<0>("lambda0", []()->std::any{return std::make_any<std::string>("hello from lambda0 !");});
 
+    // typed task: called without std::any by run<std::string(std::string,int)>("repeat", ...),
+    // and by run<2>("repeat", ...) as usual task with std::any
+    subscribe<std::string(std::string,int)>("repeat", [](std::string s, int n) { std::string r; while (n-- > 0) { r += s; } return r; });
+
     // note: we can put any type of objects for arguments our tasks,
     // with std::make_any<MyClass>(args for MyClass's ctor)
 
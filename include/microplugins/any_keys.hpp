@@ -0,0 +1,157 @@
+/** \file any_keys.hpp */
+#ifndef ANY_KEYS_HPP_INCLUDED
+#define ANY_KEYS_HPP_INCLUDED
+
+#include "rcu.hpp"
+
+#include <any>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <typeindex>
+#include <unordered_map>
+#include <vector>
+
+namespace micro {
+
+  /**
+    \class any_key
+    \brief Arguments of call as key: boxed arguments and their hash
+    \see any_keys
+  */
+  struct any_key {
+    std::vector<std::any> args; ///< arguments of call
+    std::size_t hash = 0; ///< combined hash of arguments
+  };
+
+  /**
+    \class any_keys
+    \brief Hash and equality of values in std::any by their types
+    \copyright Boost Software License - Version 1.0
+
+    Types must be registered (arithmetic types and std::string are registered already), arguments of other types
+    can not be keyed, so calls with them are not coalesced/cached. Lookup of type takes no lock (see rcu).
+
+    \code
+    micro::any_keys keys;
+    keys.add<point>(); // std::hash<point> and operator==
+    keys.add<big>([](const big& b) { return b.id; }, [](const big& a, const big& b) { return a.id == b.id; });
+    micro::any_key k;
+    if (keys.make(std::make_tuple(std::any(1), std::any(std::string("x"))), k)) { ... }
+    \endcode
+  */
+  class any_keys final {
+  public:
+
+    /** \class ops \brief Functions of registered type */
+    struct ops {
+      std::function<std::size_t(const std::any&)> hash; ///< hash of value
+      std::function<bool(const std::any&, const std::any&)> equal; ///< equality of values of this type
+      std::function<std::size_t(const std::any&)> size; ///< approximate size of value in bytes (it includes heap memory)
+    };
+
+  private:
+
+    using table = std::unordered_map<std::type_index, ops>;
+
+    rcu<table> types_;
+    std::mutex mtx_; // writers
+
+    template<typename T>
+    static std::size_t size_of(const T& v) noexcept {
+      if constexpr (std::is_same_v<T, std::string>) { return sizeof(T) + v.capacity(); }
+      else { return sizeof(T); }
+    }
+
+    template<typename... Ts>
+    void add_builtin() { (add<Ts>(), ...); }
+
+    static inline std::size_t combine(std::size_t h, std::size_t v) noexcept { return h ^ (v + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2)); }
+
+  public:
+
+    /** Creates registry with arithmetic types and std::string. */
+    any_keys():types_(std::make_unique<table>()),mtx_() {
+      add_builtin<bool, char, signed char, unsigned char, short, unsigned short, int, unsigned int, long, unsigned long,
+        long long, unsigned long long, float, double, long double, std::string>();
+    }
+
+    any_keys(const any_keys& rhs) = delete;
+
+    /** Registers type T with std::hash<T> and operator==. */
+    template<typename T>
+    void add() { add<T>(std::hash<T>(), std::equal_to<T>()); }
+
+    /** Registers type T. \param[in] h hash \param[in] eq equality \param[in] sz size in bytes, nullptr - sizeof(T) */
+    template<typename T, typename H, typename E>
+    void add(H h, E eq, std::function<std::size_t(const T&)> sz = nullptr) {
+      ops o;
+      o.hash = [h](const std::any& a) { return std::size_t(h(*std::any_cast<T>(&a))); };
+      o.equal = [eq](const std::any& a, const std::any& b) { return bool(eq(*std::any_cast<T>(&a), *std::any_cast<T>(&b))); };
+      if (sz) { o.size = [sz](const std::any& a) { return sz(*std::any_cast<T>(&a)); }; }
+      else { o.size = [](const std::any& a) { return size_of(*std::any_cast<T>(&a)); }; }
+      std::unique_lock<std::mutex> lock(mtx_);
+      auto t = std::make_unique<table>(*types_.read());
+      (*t)[std::type_index(typeid(T))] = std::move(o);
+      types_.publish(std::move(t));
+    }
+
+    /** \returns True if type is registered. \param[in] ti type */
+    bool has(const std::type_info& ti) const noexcept { return types_.read()->count(std::type_index(ti)) > 0; }
+
+    /** \returns True if all arguments have registered types (empty std::any too), k gets boxed arguments and their hash. \param[in] args arguments \param[out] k key */
+    template<typename... Ts>
+    bool make(const std::tuple<Ts...>& args, any_key& k) const {
+      k.args.clear();
+      k.args.reserve(sizeof...(Ts));
+      std::apply([&k](const auto&... xs) { (k.args.emplace_back(xs), ...); }, args);
+      auto r = types_.read();
+      std::size_t h = sizeof...(Ts);
+      for (const auto& a : k.args) {
+        if (!a.has_value()) { h = combine(h, 0); continue; }
+        auto it = r->find(std::type_index(a.type()));
+        if (it == std::end(*r)) { return false; }
+        h = combine(h, it->second.hash(a));
+      }
+      k.hash = h;
+      return true;
+    }
+
+    /** \returns True if keys have equal arguments. \param[in] a key \param[in] b key \see make() */
+    bool equal(const any_key& a, const any_key& b) const {
+      if (a.hash != b.hash || std::size(a.args) != std::size(b.args)) { return false; }
+      auto r = types_.read();
+      for (std::size_t i = 0; i < std::size(a.args); ++i) {
+        if (a.args[i].type() != b.args[i].type()) { return false; }
+        if (!a.args[i].has_value()) { continue; }
+        if (!r->at(std::type_index(a.args[i].type())).equal(a.args[i], b.args[i])) { return false; }
+      } return true;
+    }
+
+    /** \returns Approximate size of value in bytes, sizeof(std::any) for value of not registered type. \param[in] a value */
+    std::size_t size(const std::any& a) const {
+      if (!a.has_value()) { return sizeof(std::any); }
+      auto r = types_.read();
+      auto it = r->find(std::type_index(a.type()));
+      return sizeof(std::any) + (it == std::end(*r) ? 0 : it->second.size(a));
+    }
+
+    /** \class hasher \brief Hash of keys for unordered containers */
+    struct hasher { std::size_t operator()(const any_key& k) const noexcept { return k.hash; } };
+
+    /** \class equal_to \brief Equality of keys for unordered containers */
+    struct equal_to {
+      std::shared_ptr<const any_keys> keys; ///< registry of types of arguments
+      bool operator()(const any_key& a, const any_key& b) const { return keys->equal(a, b); }
+    };
+
+    any_keys& operator=(const any_keys& rhs) = delete;
+
+  };
+
+} // namespace micro
+
+#endif // ANY_KEYS_HPP_INCLUDED
@@ -0,0 +1,272 @@
+/** \file coalescer.hpp */
+#ifndef COALESCER_HPP_INCLUDED
+#define COALESCER_HPP_INCLUDED
+
+#include "thread_pool.hpp"
+
+#include <any>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <typeinfo>
+#include <vector>
+
+namespace micro {
+
+  /**
+    \class flush_timer
+    \brief One thread which closes batches of all coalescers when their windows have elapsed
+    \copyright Boost Software License - Version 1.0
+
+    Jobs of timer only close batches and post them into pool, so handlers are executed by workers.
+
+    \see coalescer
+  */
+  class flush_timer final {
+  private:
+
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    std::multimap<std::chrono::steady_clock::time_point, std::function<void()>> jobs_; // by deadlines
+    bool do_work_;
+    std::thread thread_;
+
+    flush_timer():mtx_(),cv_(),jobs_(),do_work_(true),thread_() { thread_ = std::thread(&flush_timer::loop_cb, this); }
+
+  public:
+
+    /** \returns Timer of process, its thread is started by the first call. */
+    static flush_timer& get() { static flush_timer t; return t; }
+
+    flush_timer(const flush_timer& rhs) = delete;
+
+    /** Stops the thread, jobs which are not due are dropped. */
+    ~flush_timer() {
+      { std::unique_lock<std::mutex> lock(mtx_); do_work_ = false; }
+      cv_.notify_one();
+      if (thread_.joinable()) { thread_.join(); }
+    }
+
+    /** Puts job, it is executed by thread of timer at deadline. \param[in] at deadline \param[in] job short function, it must not block */
+    void post_at(std::chrono::steady_clock::time_point at, std::function<void()> job) {
+      bool earliest = false;
+      {
+        std::unique_lock<std::mutex> lock(mtx_);
+        auto it = jobs_.emplace(at, std::move(job));
+        earliest = (it == std::begin(jobs_));
+      }
+      if (earliest) { cv_.notify_one(); }
+    }
+
+    flush_timer& operator=(const flush_timer& rhs) = delete;
+
+  private:
+
+    void loop_cb() noexcept {
+      std::unique_lock<std::mutex> lock(mtx_);
+      while (do_work_) {
+        if (std::empty(jobs_)) { cv_.wait(lock); continue; }
+        auto it = std::begin(jobs_);
+        if (it->first > std::chrono::steady_clock::now()) { cv_.wait_until(lock, it->first); continue; }
+        std::function<void()> job = std::move(it->second);
+        jobs_.erase(it);
+        lock.unlock();
+        try { job(); } catch (...) {}
+        job = nullptr;
+        lock.lock();
+      }
+    }
+
+  };
+
+  /**
+    \class icoalescer
+    \brief Interface of coalescer for untyped callers of task with arguments Ts
+    \copyright Boost Software License - Version 1.0
+
+    \see coalescer
+  */
+  template<typename... Ts>
+  class icoalescer {
+  public:
+
+    virtual ~icoalescer() {}
+
+    /** \returns Future for boxed result of call, it is ready when batch with this call is handled. \param[in] args arguments of call */
+    virtual future<std::any> run(Ts... args) = 0;
+
+    /** \returns Signature R(Args...) of batch handler. */
+    virtual const std::type_info& signature() const noexcept = 0;
+
+  };
+
+  /**
+    \class coalescer
+    \brief Micro-batching: concurrent calls of task are grouped and given to batch handler in one invocation
+    \copyright Boost Software License - Version 1.0
+
+    Arguments of calls are appended straight into contiguous arrays (one per argument), so batch is ready for handler without copying.
+    Batch is closed by the call which fills it up to max_calls or by flush_timer when window has elapsed since its first call,
+    then a worker of thread_pool calls handler and sets result of each call into own future (exception of handler goes to each call of batch).
+    Coalescer has no own thread. Result R must be default constructible (handler fills array of results).
+
+    It trades latency (at most window, plus time of handler) for throughput of batch-friendly handlers.
+
+    \see task::batch(const F& f), storage::micro_batch(const T& nm, const std::chrono::duration<Rep, Period>& window, std::size_t max_calls)
+  */
+  template<typename S, typename... Ts>
+  class coalescer;
+
+  template<typename R, typename... Args, typename... Ts>
+  class coalescer<R(Args...), Ts...> final : public icoalescer<Ts...> {
+    static_assert(std::is_default_constructible_v<R>, "\n\nResult of batch handler must be default constructible.\n");
+  public:
+
+    using handler_type = std::function<void(const std::decay_t<Args>*..., R*, std::size_t)>; ///< Type of batch handler
+
+  private:
+
+    // calls of one batch: arguments as columns and promises of callers (typed or boxed)
+    struct pending {
+      std::tuple<std::vector<std::decay_t<Args>>...> columns;
+      std::vector<promise<R>> typed;
+      std::vector<promise<std::any>> boxed;
+      std::vector<bool> is_boxed;
+      std::size_t size = 0;
+    };
+
+    // shared with jobs of timer and pool, they can outlive coalescer destroyed by continuation of own batch
+    struct shared {
+      std::shared_ptr<const handler_type> handler;
+      std::shared_ptr<thread_pool> pool;
+      std::chrono::nanoseconds window;
+      std::size_t max_calls;
+      std::mutex mtx;
+      std::shared_ptr<pending> calls; // current batch or nullptr
+      std::size_t batches = 0; // amount of opened batches, timer closes batch only with its number
+    };
+
+    std::shared_ptr<shared> shared_;
+
+    // argument of untyped caller: std::any is unboxed, other types are converted
+    template<typename A, typename T>
+    static A unbox(T&& x) {
+      if constexpr (std::is_same_v<std::decay_t<T>, std::any>) { return std::any_cast<A>(std::forward<T>(x)); }
+      else { return static_cast<A>(std::forward<T>(x)); }
+    }
+
+  public:
+
+    /** Creates coalescer. \param[in] h batch handler \param[in] window maximal time of collecting of batch \param[in] max_calls maximal amount of calls in batch */
+    template<typename Rep, typename Period>
+    coalescer(std::shared_ptr<const handler_type> h, const std::chrono::duration<Rep, Period>& window, std::size_t max_calls):
+    icoalescer<Ts...>(),shared_(std::make_shared<shared>()) {
+      shared_->handler = std::move(h);
+      shared_->pool = thread_pool::get();
+      shared_->window = std::chrono::duration_cast<std::chrono::nanoseconds>(window);
+      shared_->max_calls = max_calls ? max_calls : 1;
+    }
+
+    coalescer(const coalescer& rhs) = delete;
+
+    /** Handles collected calls by the calling thread. */
+    ~coalescer() override {
+      std::shared_ptr<pending> b;
+      { std::unique_lock<std::mutex> lock(shared_->mtx); std::swap(b, shared_->calls); }
+      if (b) { handle(*shared_->handler, *b); }
+    }
+
+    /** \returns Future for result of call. \param[in] args arguments of call */
+    template<typename... As>
+    future<R> run_as(As&&... args) {
+      promise<R> p;
+      future<R> ret = p.get_future();
+      push([&](pending& b) { b.typed.push_back(std::move(p)); b.is_boxed.push_back(false); }, std::forward<As>(args)...);
+      return ret;
+    }
+
+    /** \returns Future for boxed result of call, std::bad_any_cast for arguments of other types. \param[in] args arguments of call */
+    future<std::any> run(Ts... args) override {
+      promise<std::any> p;
+      future<std::any> ret = p.get_future();
+      try {
+        std::tuple<std::decay_t<Args>...> a(unbox<std::decay_t<Args>>(std::move(args))...);
+        std::apply([&](auto&&... xs) { push([&](pending& b) { b.boxed.push_back(std::move(p)); b.is_boxed.push_back(true); }, std::move(xs)...); }, std::move(a));
+      } catch (...) { p.set_exception(std::current_exception()); }
+      return ret;
+    }
+
+    /** \returns Signature R(Args...) of batch handler. */
+    const std::type_info& signature() const noexcept override { return typeid(R(Args...)); }
+
+    /** \returns Maximal time of collecting of batch. */
+    std::chrono::nanoseconds window() const noexcept { return shared_->window; }
+
+    /** \returns Maximal amount of calls in batch. */
+    std::size_t max_calls() const noexcept { return shared_->max_calls; }
+
+    coalescer& operator=(const coalescer& rhs) = delete;
+
+  private:
+
+    template<typename F, typename... As>
+    void push(F&& add_promise, As&&... args) {
+      shared& sh = *shared_;
+      std::shared_ptr<pending> full;
+      std::size_t opened = 0;
+      {
+        std::unique_lock<std::mutex> lock(sh.mtx);
+        if (!sh.calls) { sh.calls = std::make_shared<pending>(); opened = ++sh.batches; }
+        pending& b = *sh.calls;
+        std::apply([&](auto&... c) { (c.emplace_back(std::forward<As>(args)), ...); }, b.columns);
+        add_promise(b);
+        if (++b.size >= sh.max_calls) { std::swap(full, sh.calls); } // the next call opens new batch
+      }
+      if (full) { post(shared_, std::move(full)); }
+      else if (opened) {
+        flush_timer::get().post_at(std::chrono::steady_clock::now() + sh.window, [w = std::weak_ptr<shared>(shared_), opened]() {
+          std::shared_ptr<shared> sh = w.lock();
+          if (!sh) { return; }
+          std::shared_ptr<pending> b;
+          {
+            std::unique_lock<std::mutex> lock(sh->mtx);
+            if (sh->batches == opened) { std::swap(b, sh->calls); } // else batch was closed as full
+          }
+          if (b) { post(sh, std::move(b)); }
+        });
+      }
+    }
+
+    // closed batch is handled by worker of pool
+    static void post(const std::shared_ptr<shared>& sh, std::shared_ptr<pending> b) {
+      sh->pool->post([sh, b = std::move(b)]() { handle(*sh->handler, *b); });
+    }
+
+    static void handle(const handler_type& h, pending& b) noexcept {
+      std::vector<R> results(b.size);
+      std::exception_ptr error;
+      try { std::apply([&](const auto&... c) { h(c.data()..., results.data(), b.size); }, b.columns); }
+      catch (...) { error = std::current_exception(); }
+      for (std::size_t i = 0, t = 0, x = 0; i < b.size; ++i) {
+        if (b.is_boxed[i]) {
+          promise<std::any>& p = b.boxed[x++];
+          if (error) { p.set_exception(error); } else { p.set_value(std::move(results[i])); }
+        } else {
+          promise<R>& p = b.typed[t++];
+          if (error) { p.set_exception(error); } else { p.set_value(std::move(results[i])); }
+        }
+      }
+    }
+
+  };
+
+} // namespace micro
+
+#endif // COALESCER_HPP_INCLUDED
@@ -0,0 +1,172 @@
+/** \file coroutine.hpp */
+#ifndef COROUTINE_HPP_INCLUDED
+#define COROUTINE_HPP_INCLUDED
+
+#if defined(__has_include)
+#if __has_include(<coroutine>) && defined(__cpp_impl_coroutine)
+#define MICROPLUGINS_COROUTINES 1
+#endif
+#endif
+
+#ifdef MICROPLUGINS_COROUTINES
+
+#include "executor.hpp"
+
+#include <coroutine>
+#include <exception>
+#include <memory>
+#include <utility>
+
+namespace micro {
+
+  /**
+    \class future_promise_base
+    \brief Common part of promise of coroutine returning future
+    \copyright Boost Software License - Version 1.0
+
+    Coroutine starts immediately by the calling thread and its frame is destroyed after co_return,
+    result (or exception) goes to the returned future.
+  */
+  template<typename T>
+  class future_promise_base {
+  protected:
+
+    promise<T> promise_;
+
+  public:
+
+    /** \returns Future for result of coroutine. */
+    inline future<T> get_return_object() const noexcept { return promise_.get_future(); }
+
+    /** \returns Awaitable, coroutine is not suspended at start. */
+    inline std::suspend_never initial_suspend() const noexcept { return {}; }
+
+    /** \returns Awaitable, frame of coroutine is destroyed at end. */
+    inline std::suspend_never final_suspend() const noexcept { return {}; }
+
+    /** Sets exception of coroutine into future. */
+    inline void unhandled_exception() const { promise_.set_exception(std::current_exception()); }
+
+  };
+
+  /**
+    \class future_promise
+    \brief Promise of coroutine returning future<T>
+    \see future_promise_base
+  */
+  template<typename T>
+  class future_promise final : public future_promise_base<T> {
+  public:
+
+    /** Sets result of coroutine. \param[in] v result */
+    template<typename V>
+    inline void return_value(V&& v) const { this->promise_.set_value(std::forward<V>(v)); }
+
+  };
+
+  /**
+    \class future_promise<void>
+    \brief Promise of coroutine returning future<void>
+    \see future_promise_base
+  */
+  template<>
+  class future_promise<void> final : public future_promise_base<void> {
+  public:
+
+    /** Sets result of coroutine. */
+    inline void return_void() const { promise_.set_value(); }
+
+  };
+
+  /**
+    \class future_awaiter
+    \brief Awaitable for result of future
+    \copyright Boost Software License - Version 1.0
+
+    Suspended coroutine is resumed by the thread which sets result (see future::on_ready(std::function<void()> f)),
+    use resume_on to continue on executor. Exception of future is rethrown in coroutine.
+  */
+  template<typename T>
+  class future_awaiter final {
+  private:
+
+    future<T> future_;
+
+  public:
+
+    /** Creates awaiter. \param[in] f awaited future */
+    explicit future_awaiter(future<T> f) noexcept:future_(std::move(f)) {}
+
+    /** \returns True if coroutine does not need to be suspended (result is ready or future is empty). */
+    inline bool await_ready() const noexcept { return (!future_.valid() || future_.is_ready()); }
+
+    /** Resumes coroutine when result is ready. \param[in] h suspended coroutine */
+    inline void await_suspend(std::coroutine_handle<> h) const { future_.on_ready([h]() { h.resume(); }); }
+
+    /** \returns Result of future. \throws std::future_error for empty future, exception of task */
+    inline T await_resume() const {
+      if constexpr (std::is_void_v<T>) { future_.get(); }
+      else { return future_.get(); }
+    }
+
+  };
+
+  /** \returns Awaiter for result of future. \param[in] f awaited future */
+  template<typename T>
+  inline future_awaiter<T> operator co_await(future<T> f) noexcept { return future_awaiter<T>(std::move(f)); }
+
+  /**
+    \class resume_on
+    \brief Awaitable which continues coroutine on executor
+    \copyright Boost Software License - Version 1.0
+
+    \code
+    co_await micro::resume_on(micro::thread_pool::get()); // rest of coroutine is a job of pool
+    \endcode
+  */
+  class resume_on final {
+  private:
+
+    std::shared_ptr<iexecutor> executor_;
+    iexecutor::hints hints_;
+
+  public:
+
+    /** Creates awaitable. \param[in] e executor, coroutine is not suspended for nullptr \param[in] h hints for scheduling */
+    explicit resume_on(std::shared_ptr<iexecutor> e, const iexecutor::hints& h = {}):executor_(std::move(e)),hints_(h) {}
+
+    /** \returns True if there is no executor. */
+    inline bool await_ready() const noexcept { return !executor_; }
+
+    /** Posts resuming of coroutine to executor. \param[in] h suspended coroutine */
+    inline void await_suspend(std::coroutine_handle<> h) const { executor_->post([h]() { h.resume(); }, hints_); }
+
+    inline void await_resume() const noexcept {}
+
+  };
+
+} // namespace micro
+
+/**
+  Coroutines returning micro::future<T>.
+
+  Function returning future<std::any> is asynchronous task (see task::async), so coroutine can be subscribed
+  as task: it is started on executor of task, suspends while awaits results of other tasks and
+  its caller gets result by future without blocked thread.
+  Timers (sleeping of coroutine) are not provided, host can implement them by own awaitables.
+
+  \code
+  subscribe<1>("twice", [this](std::any a) -> micro::future<std::any> {
+    std::any x = co_await run<2>("sum2", a, a);
+    co_return 2 * std::any_cast<int>(x);
+  });
+  \endcode
+*/
+template<typename T, typename... Args>
+struct std::coroutine_traits<::micro::future<T>, Args...> {
+  using promise_type = ::micro::future_promise<T>; ///< Promise of coroutine
+};
+
+#endif // MICROPLUGINS_COROUTINES
+
+#endif // COROUTINE_HPP_INCLUDED
@@ -0,0 +1,287 @@
+/** \file executor.hpp */
+#ifndef EXECUTOR_HPP_INCLUDED
+#define EXECUTOR_HPP_INCLUDED
+
+#include "future.hpp"
+
+#include <algorithm>
+#include <any>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+
+namespace micro {
+
+  /**
+    \class iexecutor
+    \brief Interface for executors of tasks
+    \copyright Boost Software License - Version 1.0
+
+    Executor decides where and when a job will be executed.
+    Host can inject own scheduler by implementing method post(std::function<void()> job, const hints& h).
+
+    Executor can be set for kernel, for plugin or for single task.
+    Task without executor uses executor of own plugin, plugin without executor uses executor of kernel.
+
+    \code
+    class my_io_executor final : public micro::iexecutor {
+    public:
+      void post(std::function<void()> job, const hints& h = {}) override { my_io_pool.enqueue(std::move(job), h.priority); }
+    };
+
+    kernel->executor(std::make_shared<my_io_executor>()); // for all plugins
+    plugin->executor<2>("sum2", std::make_shared<micro::inline_executor>()); // for one task
+    \endcode
+
+    \see inline_executor, async_executor, dedicated_thread, thread_pool
+  */
+  class iexecutor {
+  public:
+
+    /** Hints for scheduling of jobs, executors may ignore them. */
+    struct hints {
+      int priority; ///< jobs with priority above 0 are executed ahead of queued jobs
+      int affinity; ///< preferred worker/core for job, -1 - any
+
+      /** Creates hints. \param[in] p priority \param[in] a affinity */
+      hints(int p = 0, int a = -1):priority(p),affinity(a) {}
+    };
+
+    virtual ~iexecutor() {}
+
+    /** Puts job for execution. \param[in] job function for execution \param[in] h hints for scheduling */
+    virtual void post(std::function<void()> job, const hints& h = {}) = 0;
+
+    /** \returns Amount of jobs which executor can execute at the same time, it is used for partitioning of batches. */
+    virtual std::size_t concurrency() const noexcept { return std::max(1u, std::thread::hardware_concurrency()); }
+
+    /** \returns Future for result of function. \param[in] f function without arguments \param[in] h hints for scheduling \see post() */
+    template<typename F>
+    future<std::invoke_result_t<std::decay_t<F>&>> submit(F&& f, const hints& h = {}) {
+      using R = std::invoke_result_t<std::decay_t<F>&>;
+      promise<R> p;
+      future<R> ret = p.get_future();
+      post([p, f = std::forward<F>(f)]() mutable {
+        try {
+          if constexpr (std::is_void_v<R>) { f(); p.set_value(); }
+          else { p.set_value(f()); }
+        } catch (...) { p.set_exception(std::current_exception()); }
+      }, h);
+      return ret;
+    }
+
+  };
+
+  /**
+    \class inline_executor
+    \brief Executor which executes jobs by the calling thread
+    \copyright Boost Software License - Version 1.0
+
+    Suitable for short tasks, where launching a thread costs more than the task itself.
+  */
+  class inline_executor final : public iexecutor {
+  public:
+
+    /** Executes job immediately. \param[in] job function for execution */
+    void post(std::function<void()> job, const hints& = {}) override { job(); }
+
+    /** \returns 1, jobs are executed one by one. */
+    std::size_t concurrency() const noexcept override { return 1; }
+
+  };
+
+  /**
+    \class async_executor
+    \brief Executor which executes each job in new thread
+    \copyright Boost Software License - Version 1.0
+
+    Thread per call, as std::async(std::launch::async, ...) does.
+  */
+  class async_executor final : public iexecutor {
+  public:
+
+    /** Executes job in new detached thread. \param[in] job function for execution */
+    void post(std::function<void()> job, const hints& = {}) override { std::thread(std::move(job)).detach(); }
+
+  };
+
+  /**
+    \class dedicated_thread
+    \brief Executor with one own thread
+    \copyright Boost Software License - Version 1.0
+
+    All jobs are executed one by one in order of posting (jobs with priority above 0 - ahead of others).
+    Suitable for plugins which are not thread safe or which must not compete with other plugins.
+  */
+  class dedicated_thread final : public iexecutor {
+  private:
+
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    std::deque<std::function<void()>> jobs_;
+    std::atomic<bool> do_work_;
+    std::thread thread_;
+
+  public:
+
+    /** Creates executor and starts its thread. */
+    dedicated_thread():iexecutor(),mtx_(),cv_(),jobs_(),do_work_(true),thread_() {
+      thread_ = std::thread(&dedicated_thread::loop_cb, this);
+    }
+
+    dedicated_thread(const dedicated_thread& rhs) = delete;
+
+    /** Executes queued jobs and stops the thread. Executor which is destroyed by own job detaches the thread, queued jobs are dropped then. */
+    ~dedicated_thread() override {
+      { std::unique_lock<std::mutex> lock(mtx_); do_work_ = false; }
+      cv_.notify_one();
+      if (thread_.joinable()) {
+        if (thread_.get_id() == std::this_thread::get_id()) { current() = nullptr; thread_.detach(); } // it returns without touching executor, see loop_cb()
+        else { thread_.join(); }
+      }
+    }
+
+    /** Puts job into queue of the thread. \param[in] job function for execution \param[in] h hints for scheduling, only priority is used */
+    void post(std::function<void()> job, const hints& h = {}) override {
+      {
+        std::unique_lock<std::mutex> lock(mtx_);
+        if (h.priority > 0) { jobs_.push_front(std::move(job)); }
+        else { jobs_.push_back(std::move(job)); }
+      } cv_.notify_one();
+    }
+
+    /** \returns 1, jobs are executed one by one. */
+    std::size_t concurrency() const noexcept override { return 1; }
+
+    dedicated_thread& operator=(const dedicated_thread& rhs) = delete;
+
+  private:
+
+    static dedicated_thread*& current() noexcept { static thread_local dedicated_thread* p = nullptr; return p; }
+
+    void loop_cb() noexcept {
+      current() = this;
+      std::function<void()> job;
+      while (true) {
+        {
+          std::unique_lock<std::mutex> lock(mtx_);
+          cv_.wait(lock, [this]()->bool{ return (!std::empty(jobs_) || !do_work_); });
+          if (std::empty(jobs_)) { break; }
+          job = std::move(jobs_.front());
+          jobs_.pop_front();
+        }
+        job();
+        job = nullptr;
+        if (current() != this) { return; } // executor was destroyed by the job
+      }
+    }
+
+  };
+
+  /**
+    \class adaptive_policy
+    \brief Choice between inline and asynchronous execution of tasks by their measured durations
+    \copyright Boost Software License - Version 1.0
+
+    Each task keeps moving estimate of own duration (see task_stats). Task shorter than inline_below()
+    is executed by the calling thread (launching costs more than the task), task longer than offload_above()
+    is executed by executor. Between thresholds task keeps previous decision, so it does not flip on noise.
+    Task without estimate yet is executed by executor.
+
+    Tasks with own executor, asynchronous tasks and services are never executed inline.
+    Decision counters are striped by threads, so counting does not contend.
+
+    \code
+    kernel->adaptive(std::make_shared<micro::adaptive_policy>(micro::microseconds(2), micro::microseconds(20)));
+    auto c = kernel->adaptive()->counters();
+    std::clog << c.inlined << " inline, " << c.offloaded << " offloaded" << std::endl;
+    \endcode
+  */
+  class adaptive_policy final {
+  private:
+
+    static constexpr std::size_t slots_count = 16;
+
+    struct alignas(64) slot { std::atomic<std::size_t> inlined{0}, offloaded{0}; };
+
+    std::atomic<std::int64_t> inline_below_, offload_above_; // in nanoseconds
+    slot slots_[slots_count];
+
+    static std::size_t index() noexcept {
+      static std::atomic<std::size_t> next(0);
+      static thread_local std::size_t i = next++ % slots_count;
+      return i;
+    }
+
+  public:
+
+    /** Decision counters. */
+    struct counters_type {
+      std::size_t inlined; ///< calls executed by calling thread
+      std::size_t offloaded; ///< calls given to executor
+    };
+
+    /** Creates policy. \param[in] inline_below tasks shorter than it are executed inline \param[in] offload_above tasks longer than it are executed by executor */
+    template<typename Rep1, typename Period1, typename Rep2, typename Period2>
+    adaptive_policy(const std::chrono::duration<Rep1, Period1>& inline_below, const std::chrono::duration<Rep2, Period2>& offload_above):
+    inline_below_(0),offload_above_(0),slots_() { thresholds(inline_below, offload_above); }
+
+    /** Creates policy with thresholds 1 and 10 microseconds. */
+    adaptive_policy():adaptive_policy(std::chrono::microseconds(1), std::chrono::microseconds(10)) {}
+
+    adaptive_policy(const adaptive_policy& rhs) = delete;
+
+    ~adaptive_policy() {}
+
+    /** Sets thresholds. \param[in] inline_below shorter tasks are executed inline \param[in] offload_above longer tasks are executed by executor */
+    template<typename Rep1, typename Period1, typename Rep2, typename Period2>
+    void thresholds(const std::chrono::duration<Rep1, Period1>& inline_below, const std::chrono::duration<Rep2, Period2>& offload_above) noexcept {
+      std::int64_t lo = std::chrono::duration_cast<std::chrono::nanoseconds>(inline_below).count();
+      std::int64_t hi = std::chrono::duration_cast<std::chrono::nanoseconds>(offload_above).count();
+      inline_below_.store(lo, std::memory_order_relaxed);
+      offload_above_.store(hi < lo ? lo : hi, std::memory_order_relaxed);
+    }
+
+    /** \returns Tasks shorter than it are executed inline. */
+    inline std::chrono::nanoseconds inline_below() const noexcept { return std::chrono::nanoseconds(inline_below_.load(std::memory_order_relaxed)); }
+
+    /** \returns Tasks longer than it are executed by executor. */
+    inline std::chrono::nanoseconds offload_above() const noexcept { return std::chrono::nanoseconds(offload_above_.load(std::memory_order_relaxed)); }
+
+    /** \returns True if task should be executed inline. \param[in] estimate duration in nanoseconds, negative - unknown \param[in] was_inline previous decision */
+    inline bool choose(std::int64_t estimate, bool was_inline) noexcept {
+      bool ret = (estimate >= 0) && (estimate < inline_below_.load(std::memory_order_relaxed) || (was_inline && estimate <= offload_above_.load(std::memory_order_relaxed)));
+      slot& s = slots_[index()];
+      (ret ? s.inlined : s.offloaded).fetch_add(1, std::memory_order_relaxed);
+      return ret;
+    }
+
+    /** \returns Decision counters summed over threads. */
+    counters_type counters() const noexcept {
+      counters_type ret{0, 0};
+      for (const slot& s : slots_) {
+        ret.inlined += s.inlined.load(std::memory_order_relaxed);
+        ret.offloaded += s.offloaded.load(std::memory_order_relaxed);
+      } return ret;
+    }
+
+    /** Clears decision counters. */
+    void reset_counters() noexcept {
+      for (slot& s : slots_) { s.inlined.store(0, std::memory_order_relaxed); s.offloaded.store(0, std::memory_order_relaxed); }
+    }
+
+    adaptive_policy& operator=(const adaptive_policy& rhs) = delete;
+
+  };
+
+} // namespace micro
+
+#endif // EXECUTOR_HPP_INCLUDED
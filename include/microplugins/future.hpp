@@ -0,0 +1,456 @@
+/** \file future.hpp */
+#ifndef FUTURE_HPP_INCLUDED
+#define FUTURE_HPP_INCLUDED
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <tuple>
+#include <utility>
+#include <type_traits>
+#include <vector>
+
+namespace micro {
+
+  template<typename T> class future;
+  template<typename T> class promise;
+
+  /**
+    \class future_state
+    \brief Shared state of future and promise
+    \copyright Boost Software License - Version 1.0
+
+    One allocation for value, exception, waiting and counters; memory of states is reused by free list of each thread.
+    Setter takes mutex only when somebody parks on the state or waits for continuation.
+
+    \see future, promise
+  */
+  template<typename T>
+  class future_state final {
+  private:
+
+    friend class future<T>;
+    friend class promise<T>;
+
+    static constexpr int pending = 0, has_value = 1, has_exception = 2, setting = 3;
+    static constexpr int parked = 1, continued = 2;
+
+    using value_type = std::conditional_t<std::is_void_v<T>, bool, T>;
+
+    std::atomic<std::size_t> refs_; // futures and promises
+    std::atomic<std::size_t> promises_;
+    std::atomic<int> status_; // setting - claimed by setter, value is being written
+    std::atomic<int> flags_; // parked, continued
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    std::function<void()> continuation_;
+    std::optional<value_type> value_;
+    std::exception_ptr error_;
+
+    struct free_list {
+      std::vector<void*> blocks;
+      free_list() { blocks.reserve(64); }
+      ~free_list() { destroyed() = true; for (void* p : blocks) { ::operator delete(p); } }
+    };
+
+    // trivially destructible, so it is still valid after free list of the thread was destroyed (thread exit, static teardown)
+    static bool& destroyed() noexcept { static thread_local bool b = false; return b; }
+
+    // free list of the thread, nullptr after it was destroyed (states are allocated and deleted by operator new/delete then)
+    static free_list* blocks() noexcept {
+      if (destroyed()) { return nullptr; }
+      static thread_local free_list l;
+      return &l;
+    }
+
+    future_state():refs_(1),promises_(1),status_(pending),flags_(0),mtx_(),cv_(),continuation_(),value_(),error_() {}
+
+  public:
+
+    future_state(const future_state& rhs) = delete;
+
+    ~future_state() {}
+
+    /** \returns New state, referenced by one promise. */
+    static future_state* create() {
+      free_list* l = blocks();
+      void* p = nullptr;
+      if (l && !std::empty(l->blocks)) { p = l->blocks.back(); l->blocks.pop_back(); }
+      else { p = ::operator new(sizeof(future_state)); }
+      return new (p) future_state();
+    }
+
+    /** Adds reference. */
+    inline void acquire() noexcept { refs_.fetch_add(1, std::memory_order_relaxed); }
+
+    /** Removes reference, the last one destroys state. */
+    inline void release() noexcept {
+      if (refs_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        this->~future_state();
+        free_list* l = blocks();
+        if (l && std::size(l->blocks) < 64) { l->blocks.push_back(this); }
+        else { ::operator delete(this); }
+      }
+    }
+
+    /** \returns True if value or exception was set. */
+    inline bool is_ready() const noexcept { int s = status_.load(); return (s == has_value || s == has_exception); }
+
+    /** Waits for value or exception, first by spinning, then by parking. \param[in] spins amount of checks before parking */
+    void wait(std::size_t spins) noexcept {
+      for (std::size_t i = 0; i < spins; ++i) { if (is_ready()) { return; } }
+      std::unique_lock<std::mutex> lock(mtx_);
+      flags_.fetch_or(parked);
+      cv_.wait(lock, [this]()->bool{ return is_ready(); });
+    }
+
+    /** Waits for value or exception at most given time. \param[in] d duration of waiting \returns Status of state */
+    template<typename Rep, typename Period>
+    std::future_status wait_for(const std::chrono::duration<Rep, Period>& d) noexcept {
+      if (is_ready()) { return std::future_status::ready; }
+      std::unique_lock<std::mutex> lock(mtx_);
+      flags_.fetch_or(parked);
+      return cv_.wait_for(lock, d, [this]()->bool{ return is_ready(); }) ? std::future_status::ready : std::future_status::timeout;
+    }
+
+    /** Calls function after value or exception is set (immediately, if it is set already). \param[in] f function */
+    void on_ready(std::function<void()> f) {
+      {
+        std::unique_lock<std::mutex> lock(mtx_);
+        if (continuation_) { continuation_ = [a = std::move(continuation_), b = std::move(f)]() { a(); b(); }; }
+        else { continuation_ = std::move(f); }
+        flags_.fetch_or(continued);
+        if (!is_ready()) { return; }
+        f = std::move(continuation_);
+        continuation_ = nullptr;
+      } f();
+    }
+
+    future_state& operator=(const future_state& rhs) = delete;
+
+  private:
+
+    // state is claimed before value is written, so only one of concurrent setters (copies of promise) writes it;
+    // setter stores status then loads flags, waiter stores flags then loads status (all are sequentially consistent),
+    // so either setter sees waiter or waiter sees result
+    template<typename F>
+    void set(F&& f) {
+      int s = pending;
+      if (!status_.compare_exchange_strong(s, setting)) { throw std::future_error(std::future_errc::promise_already_satisfied); }
+      try { f(); } catch (...) { status_.store(pending); throw; }
+      status_.store(error_ ? has_exception : has_value);
+      if (!flags_.load()) { return; }
+      std::function<void()> c;
+      {
+        std::unique_lock<std::mutex> lock(mtx_);
+        c = std::move(continuation_);
+        continuation_ = nullptr;
+        cv_.notify_all();
+      } if (c) { c(); }
+    }
+
+  };
+
+  template<typename T> struct unwrap_future : std::false_type { using type = T; };
+  template<typename T> struct unwrap_future<future<T>> : std::true_type { using type = T; };
+
+  /**
+    \class future
+    \brief Lightweight shared future
+    \copyright Boost Software License - Version 1.0
+
+    Result of tasks. It is copyable as std::shared_future, copies share one state (see future_state).
+    Waiting spins shortly before parking of thread, because results of short tasks are often ready in microseconds.
+    Future is converted to std::shared_future implicitly, for code which keeps results as std::shared_future.
+
+    \code
+    micro::future<std::any> result = plugin->run<2>("sum2", 10, 15);
+    std::cout << std::any_cast<int>(result.get()) << std::endl; // get() waits for result
+
+    std::shared_future<std::any> compatible = plugin->run<2>("sum2", 10, 15);
+
+    // continuations: nothing waits, follow-up work is posted to executor when result is ready
+    micro::future<int> doubled = plugin->run<2>("sum2", 10, 15).then([](const std::any& v) { return 2 * std::any_cast<int>(v); }, micro::thread_pool::get());
+    micro::future<std::any> chained = plugin->run<0>("help").then([other](const std::any& v) { return other->run<1>("print", v); }); // future<future<std::any>> is unwrapped
+    micro::when_all(std::vector<micro::future<std::any>>{ a->run<0>("load"), b->run<0>("load") }).then([](const std::vector<micro::future<std::any>>& all) { ... });
+    \endcode
+
+    \see promise
+  */
+  template<typename T>
+  class future final {
+  private:
+
+    friend class promise<T>;
+
+    future_state<T>* state_;
+
+    explicit future(future_state<T>* s) noexcept:state_(s) { if (state_) { state_->acquire(); } }
+
+  public:
+
+    static constexpr std::size_t default_spins = 256; ///< amount of checks of state before parking
+
+    /** Creates empty (invalid) future. */
+    future() noexcept:state_(nullptr) {}
+
+    /** Creates future by copyable constructor. \param[in] rhs future for copying */
+    future(const future& rhs) noexcept:future(rhs.state_) {}
+
+    /** Creates future by movable constructor. \param[in] rhs future for moving */
+    future(future&& rhs) noexcept:state_(rhs.state_) { rhs.state_ = nullptr; }
+
+    ~future() { if (state_) { state_->release(); } }
+
+    /** \returns True if future has state. */
+    inline bool valid() const noexcept { return (state_ != nullptr); }
+
+    /** \returns True if result is ready. */
+    inline bool is_ready() const noexcept { return (state_ && state_->is_ready()); }
+
+    /** Waits for result, empty future does not wait. \param[in] spins amount of checks before parking */
+    inline void wait(std::size_t spins = default_spins) const noexcept { if (state_) { state_->wait(spins); } }
+
+    /** Waits for result at most given time. \param[in] d duration of waiting \returns Status of result */
+    template<typename Rep, typename Period>
+    inline std::future_status wait_for(const std::chrono::duration<Rep, Period>& d) const noexcept {
+      return state_ ? state_->wait_for(d) : std::future_status::deferred;
+    }
+
+    /** \returns Result (reference for non-void result), rethrows exception of task. \throws std::future_error for empty future */
+    decltype(auto) get() const {
+      if (!state_) { throw std::future_error(std::future_errc::no_state); }
+      wait();
+      if (state_->error_) { std::rethrow_exception(state_->error_); }
+      if constexpr (!std::is_void_v<T>) { return static_cast<const T&>(*state_->value_); }
+    }
+
+    /** Calls function by the thread which sets result (at once, if it is ready). \param[in] f function without arguments \see then() */
+    void on_ready(std::function<void()> f) const { if (state_) { state_->on_ready(std::move(f)); } }
+
+    /** Sets result (or exception) of this future into promise, when it is ready. \param[in] p promise */
+    void forward_to(const promise<T>& p) const {
+      if (!state_) { p.set_exception(std::make_exception_ptr(std::future_error(std::future_errc::no_state))); return; }
+      on_ready([p, self = *this]() {
+        if (self.state_->error_) { p.set_exception(self.state_->error_); }
+        else if constexpr (std::is_void_v<T>) { p.set_value(); }
+        else { p.set_value(*self.state_->value_); }
+      });
+    }
+
+    /**
+      \returns Future for result of continuation, continuation returning future is unwrapped (future<future<U>> is future<U>).
+      \param[in] f continuation, it gets result of T (then exception of this future goes to returned future) or, if it does not accept result, ready future<T>
+
+      Continuation is called by the thread which sets result, so it must be short. \see then(F&& f, std::shared_ptr<E> e)
+    */
+    template<typename F>
+    inline auto then(F&& f) const { return chain(std::forward<F>(f), [](std::function<void()> job) { job(); }); }
+
+    /** \returns Future for result of continuation. \param[in] f continuation \param[in] e executor for continuation (anything with post()) \see then() */
+    template<typename F, typename E>
+    inline auto then(F&& f, std::shared_ptr<E> e) const {
+      if (!e) { return then(std::forward<F>(f)); }
+      return chain(std::forward<F>(f), [e = std::move(e)](std::function<void()> job) { e->post(std::move(job)); });
+    }
+
+    /** \returns std::shared_future with the same result, empty for empty future. */
+    std::shared_future<T> share() const {
+      if (!state_) { return {}; }
+      auto p = std::make_shared<std::promise<T>>();
+      std::shared_future<T> ret = p->get_future().share();
+      on_ready([p, self = *this]() {
+        if (self.state_->error_) { p->set_exception(self.state_->error_); }
+        else if constexpr (std::is_void_v<T>) { p->set_value(); }
+        else { p->set_value(*self.state_->value_); }
+      });
+      return ret;
+    }
+
+    /** \see share() */
+    inline operator std::shared_future<T>() const { return share(); }
+
+    /** Copyable assignment. \param[in] rhs future for copying */
+    future& operator=(const future& rhs) noexcept {
+      if (this != &rhs) { future(rhs).swap(*this); }
+      return *this;
+    }
+
+    /** Movable assignment. \param[in] rhs future for moving */
+    future& operator=(future&& rhs) noexcept {
+      if (this != &rhs) { future(std::move(rhs)).swap(*this); }
+      return *this;
+    }
+
+    /** Swaps states of futures. \param[in] rhs other future */
+    inline void swap(future& rhs) noexcept { std::swap(state_, rhs.state_); }
+
+  private:
+
+    // continuation gets result, if it accepts it, otherwise ready future
+    template<typename F>
+    static auto invoke(F& f, const future& r) {
+      if constexpr (std::is_void_v<T>) {
+        if constexpr (std::is_invocable_v<F&>) { r.get(); return f(); }
+        else { return f(r); }
+      } else {
+        if constexpr (std::is_invocable_v<F&, const T&>) { return f(r.get()); }
+        else { return f(r); }
+      }
+    }
+
+    template<typename F, typename S>
+    auto chain(F&& f, S&& schedule) const {
+      using R = decltype(invoke(std::declval<std::decay_t<F>&>(), std::declval<const future&>()));
+      using U = typename unwrap_future<R>::type;
+      if (!state_) { return future<U>(); }
+      promise<U> p;
+      future<U> ret = p.get_future();
+      std::function<void()> job = [p, f = std::forward<F>(f), self = *this]() mutable {
+        try {
+          if constexpr (unwrap_future<R>::value) { invoke(f, self).forward_to(p); }
+          else if constexpr (std::is_void_v<R>) { invoke(f, self); p.set_value(); }
+          else { p.set_value(invoke(f, self)); }
+        } catch (...) { p.set_exception(std::current_exception()); }
+      };
+      on_ready([job = std::move(job), schedule = std::forward<S>(schedule)]() mutable { schedule(std::move(job)); });
+      return ret;
+    }
+
+  };
+
+  /**
+    \class promise
+    \brief Producer of result for future
+    \copyright Boost Software License - Version 1.0
+
+    Copies of promise share one state, so promise can be captured by std::function.
+    If the last copy is destroyed without result, future gets exception std::future_errc::broken_promise.
+
+    \code
+    micro::promise<int> p;
+    micro::future<int> f = p.get_future();
+    std::thread([p]() { p.set_value(300); }).detach();
+    std::cout << f.get() << std::endl;
+    \endcode
+  */
+  template<typename T>
+  class promise final {
+  private:
+
+    future_state<T>* state_;
+
+  public:
+
+    /** Creates promise with new state. */
+    promise():state_(future_state<T>::create()) {}
+
+    /** Creates promise by copyable constructor. \param[in] rhs promise for copying */
+    promise(const promise& rhs) noexcept:state_(rhs.state_) {
+      if (state_) { state_->acquire(); state_->promises_.fetch_add(1, std::memory_order_relaxed); }
+    }
+
+    /** Creates promise by movable constructor. \param[in] rhs promise for moving */
+    promise(promise&& rhs) noexcept:state_(rhs.state_) { rhs.state_ = nullptr; }
+
+    ~promise() {
+      if (!state_) { return; }
+      if (state_->promises_.fetch_sub(1, std::memory_order_acq_rel) == 1 && !state_->is_ready()) {
+        set_exception(std::make_exception_ptr(std::future_error(std::future_errc::broken_promise)));
+      } state_->release();
+    }
+
+    /** \returns Future for result of this promise. */
+    inline future<T> get_future() const noexcept { return future<T>(state_); }
+
+    /** Sets result. \param[in] v result \throws std::future_error if result was set already */
+    template<typename... V>
+    void set_value(V&&... v) const {
+      state_->set([this, &v...]() {
+        if constexpr (std::is_void_v<T>) { state_->value_.emplace(true); }
+        else { state_->value_.emplace(std::forward<V>(v)...); }
+      });
+    }
+
+    /** Sets exception. \param[in] e exception \throws std::future_error if result was set already */
+    void set_exception(std::exception_ptr e) const {
+      state_->set([this, &e]() { state_->error_ = std::move(e); });
+    }
+
+    promise& operator=(const promise& rhs) = delete;
+
+  };
+
+  /** \returns Future with given result, it is ready at once. \param[in] v result */
+  template<typename T>
+  future<std::decay_t<T>> make_ready_future(T&& v) {
+    promise<std::decay_t<T>> p;
+    p.set_value(std::forward<T>(v));
+    return p.get_future();
+  }
+
+  /** \returns Future, which is ready when all given futures are ready, with these futures. \param[in] fs futures \see when_any(std::vector<future<T>> fs) */
+  template<typename T>
+  future<std::vector<future<T>>> when_all(std::vector<future<T>> fs) {
+    struct context {
+      std::atomic<std::size_t> left;
+      std::vector<future<T>> fs;
+      promise<std::vector<future<T>>> p;
+    };
+    auto c = std::make_shared<context>();
+    c->left = std::size(fs) + 1; // +1 until all continuations are set
+    c->fs = std::move(fs);
+    future<std::vector<future<T>>> ret = c->p.get_future();
+    auto done = [c]() { if (c->left.fetch_sub(1) == 1) { c->p.set_value(std::move(c->fs)); } };
+    for (const auto& f : c->fs) {
+      if (f.valid()) { f.on_ready(done); } else { done(); }
+    } done();
+    return ret;
+  }
+
+  /** \returns Future, which is ready when all given futures are ready, with these futures. \param[in] fs futures */
+  template<typename... Ts>
+  future<std::tuple<future<Ts>...>> when_all(future<Ts>... fs) {
+    struct context {
+      std::atomic<std::size_t> left;
+      std::tuple<future<Ts>...> fs;
+      promise<std::tuple<future<Ts>...>> p;
+    };
+    auto c = std::make_shared<context>();
+    c->left = sizeof...(Ts) + 1;
+    c->fs = std::make_tuple(std::move(fs)...);
+    future<std::tuple<future<Ts>...>> ret = c->p.get_future();
+    auto done = [c]() { if (c->left.fetch_sub(1) == 1) { c->p.set_value(std::move(c->fs)); } };
+    std::apply([&done](const auto&... f) { ((f.valid() ? f.on_ready(done) : done()), ...); }, c->fs);
+    done();
+    return ret;
+  }
+
+  /** \returns Future of the first ready future: its index (std::size(fs) for empty fs) and all futures. \param[in] fs futures \see when_all() */
+  template<typename T>
+  future<std::pair<std::size_t, std::vector<future<T>>>> when_any(std::vector<future<T>> fs) {
+    struct context {
+      std::atomic<bool> done;
+      std::vector<future<T>> fs;
+      promise<std::pair<std::size_t, std::vector<future<T>>>> p;
+    };
+    auto c = std::make_shared<context>();
+    c->done = false;
+    c->fs = std::move(fs);
+    future<std::pair<std::size_t, std::vector<future<T>>>> ret = c->p.get_future();
+    if (std::empty(c->fs)) { c->p.set_value(0, std::move(c->fs)); return ret; }
+    for (std::size_t i = 0; i < std::size(c->fs) && !c->done; ++i) {
+      auto first = [c, i]() { if (!c->done.exchange(true)) { c->p.set_value(i, c->fs); } };
+      if (c->fs[i].valid()) { c->fs[i].on_ready(first); } else { first(); }
+    } return ret;
+  }
+
+} // namespace micro
+
+#endif // FUTURE_HPP_INCLUDED
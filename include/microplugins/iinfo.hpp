@@ -2,6 +2,8 @@
 #ifndef IINFO_HPP_INCLUDED
 #define IINFO_HPP_INCLUDED
 
+#include <typeinfo>
+
 namespace micro {
 
   /**
@@ -4,6 +4,9 @@
 
 #include "iplugin.hpp"
 
+#include <map>
+#include <vector>
+
 namespace micro {
 
   /**
@@ -14,6 +17,12 @@ namespace micro {
     \copyright Boost Software License - Version 1.0
 
     Kernel's interface.
+
+    \code
+    // health of all loaded plugins with task "health", one future for all of them
+    micro::future<std::map<std::string, std::any>> all = kernel->broadcast<0>("health");
+    micro::future<int> failed = kernel->broadcast_reduce<0>("health", 0, [](int n, const std::any& ok) { return n + !std::any_cast<bool>(ok); });
+    \endcode
   */
   template<std::size_t L = MAX_PLUGINS_ARGS>
   class iplugins : public storage<L> {
@@ -37,6 +46,51 @@ namespace micro {
     /** \returns Shared pointer to loaded plugin or attempts to load it from system. \param[in] nm name of plugin */
     virtual std::shared_ptr<iplugin<L>> get_plugin(const std::string& nm) { return nm.size() ? nullptr : nullptr; }
 
+    /** \returns Future for shared pointer to loaded plugin or to plugin loaded from system (nullptr if it can not be loaded), caller is not blocked by loading. \param[in] nm name of plugin */
+    virtual future<std::shared_ptr<iplugin<L>>> get_plugin_async(const std::string& nm) {
+      return make_ready_future(get_plugin(nm));
+    }
+
+    /** \returns Loaded plugins in this moment by their keys in kernel (names by which they were loaded), plugins loaded or unloaded later are not in it. \see count_plugins(), get_plugin(const std::string& nm) */
+    virtual std::map<std::string, std::shared_ptr<iplugin<L>>> loaded_plugins() const { return {}; }
+
+    /**
+      \returns Future for results of task called concurrently on all loaded plugins which have it, by keys of plugins in kernel (see loaded_plugins()),
+      so plugins which report the same name (e.g. copies of one library) have separate results. Exception of task of any plugin is exception of future.
+      \param[in] nm index, name or key of task (see task_key) \param[in] args arguments for task (copied for each plugin)
+      \see broadcast_reduce(const T& nm, V init, F op, const Args&... args), storage::run(const T& nm, Args&&... args)
+    */
+    template<std::size_t I, typename T, typename... Args>
+    future<std::map<std::string, std::any>> broadcast(const T& nm, const Args&... args) {
+      std::vector<std::string> keys;
+      std::vector<future<std::any>> fs;
+      for (const auto& [key, pl] : loaded_plugins()) {
+        if (!pl->template has<I>(nm)) { continue; }
+        keys.push_back(key);
+        fs.push_back(pl->template run<I>(nm, args...));
+      }
+      return when_all(std::move(fs)).then([keys = std::move(keys)](const std::vector<future<std::any>>& rs) {
+        std::map<std::string, std::any> ret;
+        for (std::size_t i = 0; i < std::size(rs); ++i) {
+          if (rs[i].valid()) { ret.emplace(keys[i], rs[i].get()); } // once-called task has no result
+        } return ret;
+      });
+    }
+
+    /**
+      \returns Future for results of task called concurrently on all loaded plugins which have it, reduced by op in order of keys of plugins in kernel.
+      \param[in] nm index, name or key of task (see task_key) \param[in] init initial value \param[in] op function V(V acc, const std::any& result) \param[in] args arguments for task
+      \see broadcast(const T& nm, const Args&... args)
+    */
+    template<std::size_t I, typename T, typename V, typename F, typename... Args>
+    future<V> broadcast_reduce(const T& nm, V init, F op, const Args&... args) {
+      return broadcast<I>(nm, args...).then([init = std::move(init), op = std::move(op)](const std::map<std::string, std::any>& rs) mutable {
+        V acc = std::move(init);
+        for (const auto& r : rs) { acc = op(std::move(acc), r.second); }
+        return acc;
+      });
+    }
+
   };
 
 } // namespace micro
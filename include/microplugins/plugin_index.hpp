@@ -0,0 +1,190 @@
+/** \file plugin_index.hpp */
+#ifndef PLUGIN_INDEX_HPP_INCLUDED
+#define PLUGIN_INDEX_HPP_INCLUDED
+
+#include "rcu.hpp"
+#include "shared_library.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace micro {
+
+  /**
+    \class plugin_index
+    \brief Libraries of plugins in search directories by names of plugins
+    \copyright Boost Software License - Version 1.0
+
+    Search directories (see shared_library::search_paths(const std::string& path0)) are scanned once by refresh(),
+    then library of plugin is resolved by hash lookup. Names are matched like by shared_library::load(name_lib, path0, flags):
+    file `libplugin1-1.2.so' is found by names `plugin1-1.2', `plugin1' (version `1.2') and `plugin' (version `1-1.2').
+    Lookup takes no lock (see rcu), so index can be refreshed while plugins are loaded.
+
+    \code
+    micro::plugin_index index("microplugins");
+    index.refresh();
+    for (const auto& e : index.find("plugin1")) { std::cout << e.filename << " " << e.version << std::endl; }
+    \endcode
+
+    \see plugins::refresh_index()
+  */
+  class plugin_index final {
+  public:
+
+    /** \class entry \brief Library of plugin */
+    struct entry {
+      std::string filename; ///< path to library
+      std::string version; ///< version from name of file, it can be empty
+    };
+
+    using stamp_t = std::vector<std_filesystem::file_time_type>; ///< modification times of search directories
+
+  private:
+
+    struct snapshot {
+      std::unordered_map<std::string, std::vector<entry>> names; // libraries in order of search
+      std::vector<std::string> dirs;
+      stamp_t stamp;
+      std::size_t files = 0;
+    };
+
+    static constexpr std::size_t max_version = 12; // like filter of shared_library
+
+    std::string path0_;
+    rcu<snapshot> snapshot_;
+    std::mutex mtx_; // writers
+
+    #if defined(_WIN32)
+    static constexpr const char* suffix = ".dll";
+    #elif defined(__APPLE__)
+    static constexpr const char* suffix = ".dylib";
+    #else
+    static constexpr const char* suffix = ".so";
+    #endif
+
+    static bool is_version(char c) noexcept { return std::isdigit(static_cast<unsigned char>(c)) || c == '.' || c == '_' || c == '-'; }
+
+    static bool is_version(const std::string& s) noexcept { return std::size(s) <= max_version && std::all_of(std::begin(s), std::end(s), [](char c) { return is_version(c); }); }
+
+    static std::string lower(std::string s) {
+      #if defined(_WIN32)
+      for (auto& c : s) { c = char(std::tolower(static_cast<unsigned char>(c))); }
+      #endif
+      return s;
+    }
+
+    static std::string trim(const std::string& s) {
+      std::size_t b = s.find_first_not_of("._-"), e = s.find_last_not_of("._-");
+      return b == std::string::npos ? std::string() : s.substr(b, e - b + 1);
+    }
+
+    // adds library under all names, which it is found by
+    static void add(snapshot& s, const std::string& fn, const std::string& filename) {
+      auto nms = names(fn);
+      for (auto& n : nms) { s.names[std::move(n.first)].push_back(entry{filename, std::move(n.second)}); }
+      if (!std::empty(nms)) { ++s.files; }
+    }
+
+  public:
+
+    /** Creates empty index. \param[in] path0 paths for search exploded by ':' \see refresh() */
+    explicit plugin_index(const std::string& path0 = {}):path0_(path0),snapshot_(std::make_unique<snapshot>()),mtx_() {}
+
+    plugin_index(const plugin_index& rhs) = delete;
+
+    /** \returns True if plugin is looked up by index, names of files (with suffix of library or directory) are not. \param[in] nm name of plugin */
+    static bool is_indexable(const std::string& nm) {
+      return !nm.empty() && lower(nm).find(suffix) == std::string::npos && nm.find_first_of("/\\") == std::string::npos;
+    }
+
+    /**
+      \returns Names of plugin with versions, by which library is found, empty if file is not library.
+      \param[in] fn name of file without directory \see find(const std::string& nm)
+    */
+    static std::vector<std::pair<std::string, std::string>> names(const std::string& fn) {
+      std::vector<std::pair<std::string, std::string>> ret;
+      const std::string l = lower(fn);
+      std::size_t pos = l.rfind(suffix);
+      while (pos != std::string::npos && !is_version(fn.substr(pos + std::char_traits<char>::length(suffix)))) {
+        pos = pos ? l.rfind(suffix, pos - 1) : std::string::npos;
+      }
+      if (pos == std::string::npos) { return ret; }
+      std::string stem = fn.substr(0, pos), tail = fn.substr(pos + std::char_traits<char>::length(suffix));
+      #if defined(_WIN32)
+      std::vector<std::string> bases = {stem};
+      if (lower(stem).find("lib") == 0) { bases.push_back(stem.substr(3)); }
+      #else
+      if (stem.find("lib") != 0) { return ret; }
+      std::vector<std::string> bases = {stem.substr(3)};
+      #endif
+      for (const auto& base : bases) {
+        for (std::size_t i = std::size(base); i > 0 && std::size(base) - i <= max_version; --i) {
+          if (i < std::size(base) && !is_version(base[i])) { break; }
+          ret.emplace_back(lower(base.substr(0, i)), trim(base.substr(i) + tail));
+        }
+      } return ret;
+    }
+
+    /** Scans search directories again. \see shared_library::search_paths(const std::string& path0) */
+    void refresh() {
+      std::unique_lock<std::mutex> lock(mtx_);
+      auto s = std::make_unique<snapshot>();
+      s->dirs = shared_library::search_paths(path0_);
+      s->stamp = stamp(s->dirs); // before scan, so changes while scanning make index stale
+      std::error_code ec;
+      for (const auto& d : s->dirs) {
+        std_filesystem::path p(d);
+        if (!std_filesystem::is_directory(p, ec)) { continue; }
+        std_filesystem::directory_iterator dir_iter(p, ec), end_iter;
+        for (; dir_iter != end_iter; dir_iter.increment(ec)) {
+          if (!std_filesystem::is_regular_file(dir_iter->status(ec))) { continue; }
+          add(*s, dir_iter->path().filename().generic_string(), dir_iter->path().generic_string());
+        }
+      }
+      snapshot_.publish(std::move(s));
+    }
+
+    /** \returns Libraries of plugin in order of search, empty if plugin is not found. \param[in] nm name of plugin */
+    std::vector<entry> find(const std::string& nm) const {
+      std::string k = lower(nm);
+      #if !defined(_WIN32)
+      if (k.find("lib") == 0) { k.erase(0, 3); }
+      #endif
+      auto r = snapshot_.read();
+      auto it = r->names.find(k);
+      return it == std::end(r->names) ? std::vector<entry>() : it->second;
+    }
+
+    /** \returns Search directories of index. */
+    std::vector<std::string> dirs() const { return snapshot_.read()->dirs; }
+
+    /** \returns Amount of indexed libraries. */
+    std::size_t size() const noexcept { return snapshot_.read()->files; }
+
+    /** \returns Modification times of search directories in this moment, they are changed by adding, removing and renaming of files. */
+    stamp_t stamp() const { return stamp(dirs()); }
+
+    /** \returns Modification times of directories. \param[in] dirs directories */
+    static stamp_t stamp(const std::vector<std::string>& dirs) {
+      stamp_t ret;
+      std::error_code ec;
+      for (const auto& d : dirs) {
+        auto t = std_filesystem::last_write_time(std_filesystem::path(d), ec);
+        ret.push_back(ec ? std_filesystem::file_time_type::min() : t);
+      } return ret;
+    }
+
+    /** \returns True if search directories were changed since refresh(). \param[in] s modification times of search directories (see stamp()) */
+    bool is_stale(const stamp_t& s) const { return s != snapshot_.read()->stamp; }
+
+    plugin_index& operator=(const plugin_index& rhs) = delete;
+
+  };
+
+} // namespace micro
+
+#endif // PLUGIN_INDEX_HPP_INCLUDED
@@ -0,0 +1,140 @@
+/** \file plugin_watcher.hpp */
+#ifndef PLUGIN_WATCHER_HPP_INCLUDED
+#define PLUGIN_WATCHER_HPP_INCLUDED
+
+#include <chrono>
+#include <functional>
+#include <map>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace micro {
+
+  /**
+    \class plugin_watcher
+    \brief Notifications about changed files in directories of plugins
+    \copyright Boost Software License - Version 1.0
+
+    Thread of watcher sleeps until files in directories are closed after writing, moved or removed (Linux inotify),
+    filesystem is not polled. File which is being written is not reported until it is closed, however long the copying takes.
+    Burst of events (several libraries) is reported once, when directories are quiet for a while.
+    Queue overflow of inotify is reported as change of all directories. Directories, which do not exist when watcher is created,
+    are not watched. On other systems nothing is watched (see is_watching()).
+
+    \code
+    micro::plugin_watcher w({"plugins/"}, [](const std::vector<std::string>& files) { for (const auto& f : files) { std::cout << f << std::endl; } });
+    \endcode
+
+    \see plugins::watch(bool reload)
+  */
+  class plugin_watcher final {
+  public:
+
+    using callback_t = std::function<void(const std::vector<std::string>&)>; ///< changed files (directory and name of file)
+
+  private:
+
+    int fd_; // inotify
+    int wake_[2]; // pipe for stopping of thread
+    std::map<int, std::string> dirs_; // directories by watch descriptors
+    callback_t cb_;
+    std::chrono::milliseconds quiet_;
+    std::thread thread_;
+
+    #if defined(__linux__)
+    // collects names of changed files, false if nothing was read
+    bool read_events(std::set<std::string>& changed) {
+      alignas(inotify_event) char buf[4096];
+      bool ret = false;
+      ssize_t n = 0;
+      while ((n = ::read(fd_, buf, sizeof(buf))) > 0) {
+        ret = true;
+        for (char* p = buf; p < buf + n; p += sizeof(inotify_event) + reinterpret_cast<inotify_event*>(p)->len) {
+          const inotify_event* ev = reinterpret_cast<inotify_event*>(p);
+          if (ev->mask & IN_Q_OVERFLOW) { for (const auto& d : dirs_) { changed.insert(d.second); } continue; } // events are lost, directories are reported
+          if (!ev->len || (ev->mask & IN_ISDIR)) { continue; }
+          if (auto it = dirs_.find(ev->wd); it != std::end(dirs_)) { changed.insert(it->second + ev->name); }
+        }
+      } return ret;
+    }
+
+    void loop_cb() {
+      std::set<std::string> changed;
+      pollfd fds[2] = {{fd_, POLLIN, 0}, {wake_[0], POLLIN, 0}};
+      while (true) {
+        // without changes it sleeps until event, with changes it waits for quiet directories
+        int r = ::poll(fds, 2, std::empty(changed) ? -1 : int(quiet_.count()));
+        if (r < 0) { continue; }
+        if (fds[1].revents) { break; }
+        if (r > 0 && read_events(changed)) { continue; }
+        if (!std::empty(changed)) {
+          std::vector<std::string> files(std::begin(changed), std::end(changed));
+          changed.clear();
+          cb_(files);
+        }
+      }
+    }
+    #endif
+
+  public:
+
+    /**
+      Creates watcher and starts its thread.
+      \param[in] dirs directories (with trailing '/') \param[in] cb callback for changed files, it is called by thread of watcher
+      \param[in] quiet time without events before changes are reported
+    */
+    plugin_watcher(const std::vector<std::string>& dirs, callback_t cb, std::chrono::milliseconds quiet = std::chrono::milliseconds(100)):
+    fd_(-1),wake_{-1, -1},dirs_(),cb_(std::move(cb)),quiet_(quiet),thread_() {
+      #if defined(__linux__)
+      if ((fd_ = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) < 0) { return; }
+      for (const auto& d : dirs) {
+        int wd = ::inotify_add_watch(fd_, d.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE | IN_ONLYDIR);
+        if (wd >= 0) { dirs_.emplace(wd, d); } // the same directory by other path has the same descriptor, the first path is kept
+      }
+      if (std::empty(dirs_) || ::pipe2(wake_, O_CLOEXEC | O_NONBLOCK) < 0) { ::close(fd_); fd_ = -1; dirs_.clear(); return; }
+      thread_ = std::thread(&plugin_watcher::loop_cb, this);
+      #else
+      (void)dirs;
+      #endif
+    }
+
+    plugin_watcher(const plugin_watcher& rhs) = delete;
+
+    /** Stops thread of watcher, it waits for callback in progress (so watcher must not be destroyed by its callback). */
+    ~plugin_watcher() {
+      #if defined(__linux__)
+      if (thread_.joinable()) {
+        [[maybe_unused]] ssize_t r = ::write(wake_[1], "", 1);
+        thread_.join();
+      }
+      if (fd_ >= 0) { ::close(fd_); }
+      if (wake_[0] >= 0) { ::close(wake_[0]); ::close(wake_[1]); }
+      #endif
+    }
+
+    /** \returns True if at least one directory is watched. */
+    bool is_watching() const noexcept { return thread_.joinable(); }
+
+    /** \returns Watched directories. */
+    std::vector<std::string> dirs() const {
+      std::vector<std::string> ret;
+      for (const auto& d : dirs_) { ret.push_back(d.second); }
+      return ret;
+    }
+
+    plugin_watcher& operator=(const plugin_watcher& rhs) = delete;
+
+  };
+
+} // namespace micro
+
+#endif // PLUGIN_WATCHER_HPP_INCLUDED
@@ -3,10 +3,15 @@
 #define PLUGINS_HPP_INCLUDED
 
 #include "iplugins.hpp"
+#include "plugin_index.hpp"
+#include "plugin_watcher.hpp"
 #include "shared_library.hpp"
 #include "singleton.hpp"
 
+#include <condition_variable>
 #include <iostream> // std::clog
+#include <list>
+#include <unordered_map>
 
 /**
   \mainpage Documentation API
@@ -20,6 +25,8 @@
 
   - It takes care for unloading unused plugins automatically by given time.
 
+  - It executes tasks by bounded work-stealing pool of threads (or by thread per call, if you want).
+
   # Requirements
   - Compiler with support C++17 standart (including experimental filesystem)
 
@@ -84,7 +91,7 @@
     std::shared_ptr<micro::iplugin<>> plugin1 = k->get_plugin("plugin1");
 
     if (plugin1 && plugin1->has<2>("sum2")) {
-      std::shared_future<std::any> result = plugin1->run<2>("sum2", 125, 175);
+      micro::future<std::any> result = plugin1->run<2>("sum2", 125, 175);
       result.wait();
       std::cout << std::any_cast<int>(result.get()) << std::endl;
     }
@@ -119,6 +126,17 @@ namespace micro {
 
     Class for loading and unloading plugins. Plugins has shared pointer to it.
 
+    Tasks of kernel and of plugins without own executor are executed by executor of kernel,
+    it is pool() by default and can be replaced by storage::executor(std::shared_ptr<iexecutor> e).
+    With adaptive dispatch (see adaptive(inline_below, offload_above)) short tasks are executed by the calling thread instead.
+
+    Unloaded or swapped plugin (see swap_plugin(const std::string& nm)) is retired by its last user: library is unloaded
+    after all shared pointers to the plugin, handed out by kernel, are released and calls of plugin in flight have returned (see storage::in_flight()).
+    Unloading and stopping are woken by retirement, kernel is not locked and nothing is polled meanwhile.
+
+    New copy of swapped plugin is loaded with RTLD_LOCAL (and RTLD_DEEPBIND, where it exists), so it runs own code,
+    even if it exports symbols which are exported by its previous copy too. Other plugins are loaded with RTLD_GLOBAL.
+
     \example microservice.cxx
   */
   template<std::size_t L = MAX_PLUGINS_ARGS>
@@ -128,17 +146,102 @@ namespace micro {
     friend class singleton<plugins<L>>;
 
     std::atomic<bool> do_work_, expiry_;
+    std::mutex state_mtx_; // run() and stop()
+    std::mutex loop_mtx_; // thread of management sleeps on loop_cv_, stop() waits on it for expiry_
+    std::condition_variable loop_cv_;
     std::atomic<int> error_, max_idle_;
     std::string path_; // paths for plugins
+    std::shared_ptr<thread_pool> pool_; // workers for tasks of kernel and plugins
+    std::mutex loader_mtx_;
+    std::shared_ptr<dedicated_thread> loader_; // thread of asynchronous loading, it is created by the first one
+    std::shared_ptr<plugin_index> index_; // libraries of plugins in search directories
+
+    // threads of blocking jobs of kernel (services, swapping and retirement of plugins), finished ones are joined by the next spawn() and by stop()
+    struct helpers {
+      std::mutex mtx;
+      std::condition_variable cv;
+      std::list<std::thread> running;
+      std::vector<std::thread> finished;
+      std::chrono::nanoseconds timeout = std::chrono::seconds(10); // of waiting of stop()
+
+      // the last thread can release helpers, it returns without touching them
+      ~helpers() { for (auto& t : finished) { if (t.get_id() == std::this_thread::get_id()) { t.detach(); } else { t.join(); } } }
+
+      static void spawn(const std::shared_ptr<helpers>& h, std::function<void()> job) {
+        std::vector<std::thread> done;
+        std::unique_lock<std::mutex> lock(h->mtx);
+        done.swap(h->finished);
+        auto it = h->running.emplace(std::end(h->running));
+        try {
+          *it = std::thread([h, it, job = std::move(job)]() mutable {
+            try { job(); } catch (...) {}
+            job = nullptr; // captures (plugin or library) are released before thread is finished
+            std::unique_lock<std::mutex> lock(h->mtx); // thread was stored by spawn() under this lock
+            h->finished.push_back(std::move(*it));
+            h->running.erase(it);
+            h->cv.notify_all();
+          });
+        } catch (...) { h->running.erase(it); }
+        lock.unlock();
+        for (auto& t : done) { t.join(); }
+      }
+
+      // waits for threads except the calling one until deadline, false - some are running yet
+      bool join(std::chrono::steady_clock::time_point deadline) {
+        std::vector<std::thread> done;
+        std::unique_lock<std::mutex> lock(mtx);
+        bool ret = cv.wait_until(lock, deadline, [this]() {
+          return std::all_of(std::begin(running), std::end(running), [](const std::thread& t) { return t.get_id() == std::this_thread::get_id(); });
+        });
+        done.swap(finished);
+        lock.unlock();
+        for (auto& t : done) { t.join(); }
+        return ret;
+      }
+    };
 
     std::map<
       std::string,
       std::tuple<
         std::shared_ptr<shared_library>,
-        std::shared_ptr<iplugin<>>
+        std::shared_ptr<iplugin<>>, // plugin handed out by kernel
+        std::string, // file of library (library of swapped plugin is loaded by its copy)
+        future<bool> // retirement of plugin
       >
     > plugins_;
 
+    std::shared_ptr<helpers> helpers_;
+
+    // copy of swapped plugin is local and it binds own symbols first, so they are not bound to previous copy which is loaded yet
+    #ifdef RTLD_DEEPBIND
+    static constexpr int swap_flags = RTLD_LOCAL|RTLD_LAZY|RTLD_DEEPBIND;
+    #else
+    static constexpr int swap_flags = RTLD_LOCAL|RTLD_LAZY;
+    #endif
+
+    // loading of plugin, it is done by the first of its callers (asynchronous loading can wait in queue of executor meanwhile)
+    struct loading {
+      promise<std::shared_ptr<iplugin<>>> done;
+      future<std::shared_ptr<iplugin<>>> result;
+      std::atomic<bool> claimed;
+
+      loading():done(),result(done.get_future()),claimed(false) {}
+
+      inline bool claim() noexcept { return !claimed.exchange(true); }
+    };
+
+    std::map<std::string, std::shared_ptr<loading>> loading_; // plugins in loading, their callers wait for one loading
+
+    std::mutex miss_mtx_; // negative lookups
+    std::unordered_map<std::string, std::chrono::steady_clock::time_point> missing_; // plugins which were not loaded, until expiration
+    std::chrono::nanoseconds miss_ttl_; // time to live of negative lookup, zero - lookups are not cached
+    plugin_index::stamp_t dirs_stamp_; // modification times of search directories when lookups failed
+    std::chrono::steady_clock::time_point dirs_checked_;
+
+    std::mutex watch_mtx_; // watcher
+    std::atomic<bool> watched_, reload_; // search directories are watched, changed plugins are swapped
+    std::unique_ptr<plugin_watcher> watcher_; // it is destroyed first, so its callback does not see destroyed members
+
     /**
       Creates plugins object
 
@@ -150,7 +253,12 @@ namespace micro {
     */
     explicit plugins(int v = make_version(1,0), const std::string& nm = "microplugins service", const std::string& path0 = "microplugins"):
     iplugins<>(v, nm),singleton<plugins<L>>(),std::enable_shared_from_this<plugins<L>>(),
-    do_work_(false),expiry_(true),error_(0),max_idle_(10),path_(path0),plugins_() {}
+    do_work_(false),expiry_(true),state_mtx_(),loop_mtx_(),loop_cv_(),error_(0),max_idle_(10),path_(path0),pool_(thread_pool::get()),loader_mtx_(),loader_(),index_(std::make_shared<plugin_index>(path0)),
+    plugins_(),helpers_(std::make_shared<helpers>()),loading_(),
+    miss_mtx_(),missing_(),miss_ttl_(std::chrono::seconds(5)),dirs_stamp_(),dirs_checked_(),
+    watch_mtx_(),watched_(false),reload_(false),watcher_() {
+      storage<>::executor(pool_);
+    }
 
   public:
 
@@ -160,6 +268,9 @@ namespace micro {
     /** \see storage::unsubscribe(const T& nm) */
     using storage<>::unsubscribe;
 
+    /** \see storage::adaptive(), storage::adaptive(std::shared_ptr<adaptive_policy> a) */
+    using storage<>::adaptive;
+
     plugins& operator=(const plugins& rhs) = delete;
 
     plugins& operator=(plugins&& rhs) = delete;
@@ -183,8 +294,124 @@ namespace micro {
     /** Sets max idle. All loaded plugins thats has idle more or equal to it value will be unloaded. \param[in] i value in minutes, 0 - for unlimited resident loaded plugins in RAM. \see max_idle() */
     void max_idle(int i) noexcept { if (i >= 0) { max_idle_ = i; } }
 
+    /** \returns Time to live of negative lookup. \see negative_ttl(const std::chrono::duration<Rep, Period>& ttl) */
+    std::chrono::nanoseconds negative_ttl() noexcept { std::unique_lock<std::mutex> lock(miss_mtx_); return miss_ttl_; }
+
+    /**
+      Sets time to live of negative lookup: plugin which was not loaded is not searched again until it expires (default 5 seconds),
+      or until search directories are changed (it is checked once per second). \param[in] ttl time to live, zero - lookups are not cached
+      \see get_plugin(const std::string& nm), forget_missing()
+    */
+    template<typename Rep, typename Period>
+    void negative_ttl(const std::chrono::duration<Rep, Period>& ttl) noexcept {
+      std::unique_lock<std::mutex> lock(miss_mtx_);
+      miss_ttl_ = std::chrono::duration_cast<std::chrono::nanoseconds>(ttl);
+      if (!miss_ttl_.count()) { missing_.clear(); }
+    }
+
+    /** Forgets negative lookups, next calls of get_plugin(const std::string& nm) search plugins again. \see negative_ttl(const std::chrono::duration<Rep, Period>& ttl) */
+    void forget_missing() noexcept { std::unique_lock<std::mutex> lock(miss_mtx_); missing_.clear(); }
+
+    /**
+      Watches search directories (Linux inotify) until unwatch() or stop(): when libraries are created, changed or removed,
+      index is refreshed and negative lookups are forgotten, so get_plugin(const std::string& nm) does not check directories itself.
+      \returns True if directories are watched \param[in] reload loaded plugins with changed libraries are swapped (see swap_plugin(const std::string& nm))
+      \see plugin_watcher
+    */
+    bool watch(bool reload = false) {
+      auto w = std::make_unique<plugin_watcher>(shared_library::search_paths(path_), [this](const std::vector<std::string>& files) { changed(files); });
+      if (!w->is_watching()) { w.reset(); }
+      bool ret = bool(w);
+      {
+        std::unique_lock<std::mutex> lock(watch_mtx_);
+        reload_ = reload;
+        watcher_.swap(w);
+        watched_ = ret;
+      }
+      if (ret) { index_->refresh(); forget_missing(); } // changes before watching
+      return ret; // previous watcher is stopped without lock
+    }
+
+    /** Stops watching of search directories. \see watch(bool reload) */
+    void unwatch() noexcept {
+      std::unique_ptr<plugin_watcher> w;
+      {
+        std::unique_lock<std::mutex> lock(watch_mtx_);
+        watcher_.swap(w);
+        watched_ = false;
+      }
+    }
+
+    /** \returns True if search directories are watched. \see watch(bool reload) */
+    bool is_watching() const noexcept { return watched_; }
+
+    /**
+      \returns Plugin of new version, nullptr if it can not be loaded (loaded version stays then).
+      New version is loaded alongside loaded one (by own copy of library) and replaces it at once: get_plugin(const std::string& nm)
+      returns new version, while users of old version keep it until they release it. Old version is retired (its caches are dropped,
+      instance and library are released) by its last user, kernel is not locked and plugin is available meanwhile.
+      Service of old version is stopped (see iplugin::is_run()). \param[in] nm name of plugin (names of files are not swapped)
+
+      \code
+      std::shared_ptr<micro::iplugin<>> v1 = kernel->get_plugin("plugin1");
+      // libplugin1.so is replaced by new version
+      std::shared_ptr<micro::iplugin<>> v2 = kernel->swap_plugin("plugin1"); // v1 is still usable
+      v1 = nullptr; // the last user of old version releases it
+      \endcode
+    */
+    std::shared_ptr<iplugin<>> swap_plugin(const std::string& nm) {
+      if (!do_work_ || !plugin_index::is_indexable(nm)) { return nullptr; }
+      if (!watched_) { index_->refresh(); } // new version can be in new file
+      std::shared_ptr<iplugin<>> ret = nullptr;
+      std::shared_ptr<shared_library> dll = std::make_shared<shared_library>();
+      std::string file;
+      try {
+        for (const auto& e : index_->find(nm)) {
+          if (open_copy(*dll, e.filename) && (ret = import(*dll))) { file = e.filename; break; }
+        }
+      } catch (...) { ret = nullptr; }
+      typename decltype(plugins_)::mapped_type old;
+      {
+        std::unique_lock<std::shared_mutex> lock(storage<>::mtx_);
+        #if (!defined(NDEBUG) || defined(DEBUG))
+        std::clog << "[microplugins] status of swapping plugin '" << nm << "': " << ((ret && do_work_) ? "success" : "fail") << std::endl;
+        #endif
+        if (!ret || !do_work_) { ret = nullptr; return nullptr; } // instance is released before its library
+        if (auto it = plugins_.find(nm); it != std::end(plugins_)) {
+          old = std::move(it->second);
+          std::get<1>(old)->do_work_ = false; // service of old version
+          plugins_.erase(it);
+        }
+        ret = attach(nm, dll, ret, file);
+      } // old version is released without lock
+      return ret;
+    }
+
+    /**
+      Sets thresholds of adaptive dispatch for tasks of kernel and of plugins without own executor, it creates policy if kernel has no one.
+      \param[in] inline_below tasks shorter than it are executed by the calling thread \param[in] offload_above tasks longer than it are executed by executor
+      \see adaptive_policy, storage::adaptive(std::shared_ptr<adaptive_policy> a)
+    */
+    template<typename Rep1, typename Period1, typename Rep2, typename Period2>
+    void adaptive(const std::chrono::duration<Rep1, Period1>& inline_below, const std::chrono::duration<Rep2, Period2>& offload_above) {
+      if (auto a = storage<>::adaptive(); a) { a->thresholds(inline_below, offload_above); }
+      else { storage<>::adaptive(std::make_shared<adaptive_policy>(inline_below, offload_above)); }
+    }
+
+    /** \returns Shared pointer to pool of threads of kernel. \see storage::executor(), storage::executor(std::shared_ptr<iexecutor> e) */
+    std::shared_ptr<thread_pool> pool() const noexcept { return pool_; }
+
+    /** \returns Index of libraries of plugins in search directories. \see refresh_index() */
+    std::shared_ptr<const plugin_index> index() const noexcept { return index_; }
+
+    /** Scans search directories for libraries of plugins again, it is done by run() and when library of plugin is not found. \see index() */
+    void refresh_index() { index_->refresh(); }
+
     /** Runs thread for manage plugins. If plugins kernel has task with name `service' it will called once. \see is_run() */
     void run() noexcept {
+      if (do_work_) { return; }
+      std::unique_lock<std::mutex> state(state_mtx_); // stopping is finished first
+      index_->refresh(); // plugins are resolved by index, search directories are not scanned by each loading
       std::unique_lock<std::shared_mutex> lock(storage<>::mtx_);
       if (do_work_) { return; }
       error_ = 0;
@@ -194,14 +421,41 @@ namespace micro {
       std::thread(&plugins<>::service_cb, plugins<>::shared_from_this(), plugins<>::shared_from_this()).detach();
     }
 
-    /** Stops thread of management plugins. \see run(), is_run() */
+    /** Stops thread of management plugins and watching of search directories, it returns after plugins are retired or after retire_timeout(). \see run(), is_run() */
     void stop() noexcept {
-      std::unique_lock<std::shared_mutex> lock(storage<>::mtx_);
-      if (!do_work_) { return; }
-      do_work_ = false;
-      while (!expiry_) { micro::sleep<micro::milliseconds>(50); }
-      unload_plugins();
+      unwatch();
+      std::unique_lock<std::mutex> state(state_mtx_);
+      {
+        std::unique_lock<std::shared_mutex> lock(storage<>::mtx_);
+        if (!do_work_) { return; }
+        std::unique_lock<std::mutex> loop(loop_mtx_);
+        do_work_ = false;
+      }
+      loop_cv_.notify_all();
+      {
+        std::unique_lock<std::mutex> loop(loop_mtx_);
+        loop_cv_.wait(loop, [this]() { return bool(expiry_); }); // thread of management can wait for lock of kernel meanwhile
+      }
+      const auto deadline = std::chrono::steady_clock::now() + retire_timeout();
+      bool retired = unload_plugins(deadline);
       storage<>::clear_once();
+      retired = helpers_->join(deadline) && retired; // libraries are unloaded and services are finished before return
+      #if (!defined(NDEBUG) || defined(DEBUG))
+      if (!retired) { std::clog << "[microplugins] stop: plugins are not retired in time (held by users or called), they will be retired by their last users" << std::endl; }
+      #endif
+    }
+
+    /** \returns Maximal time of waiting of stop() for retirement of plugins. \see retire_timeout(const std::chrono::duration<Rep, Period>& t) */
+    std::chrono::nanoseconds retire_timeout() const noexcept { std::unique_lock<std::mutex> lock(helpers_->mtx); return helpers_->timeout; }
+
+    /**
+      Sets maximal time of waiting of stop() for retirement of plugins (default 10 seconds): plugin which is still held by its user
+      or called after it is retired by its last user, stop() does not wait for it longer. \param[in] t timeout \see stop()
+    */
+    template<typename Rep, typename Period>
+    void retire_timeout(const std::chrono::duration<Rep, Period>& t) noexcept {
+      std::unique_lock<std::mutex> lock(helpers_->mtx);
+      helpers_->timeout = std::chrono::duration_cast<std::chrono::nanoseconds>(t);
     }
 
     /** \returns Amount of loaded plugins in this moment. \see iplugins::count_plugins() */
@@ -210,34 +464,45 @@ namespace micro {
       return do_work_ ? std::size(plugins_) : 0;
     }
 
-    /** \returns Shared pointer to plugin. \param[in] nm name of plugin \see iplugins::get_plugin(const std::string& nm) */
+    /**
+      \returns Shared pointer to plugin, it is loaded from system if it was not loaded yet.
+      Loading is done without lock of kernel, concurrent callers for the same plugin wait for one loading.
+      Plugin which was not loaded is not searched again for a while (see negative_ttl(const std::chrono::duration<Rep, Period>& ttl)).
+      \param[in] nm name of plugin \see iplugins::get_plugin(const std::string& nm), get_plugin_async(const std::string& nm)
+    */
     std::shared_ptr<iplugin<>> get_plugin(const std::string& nm) override {
-      std::unique_lock<std::shared_mutex> lock(storage<>::mtx_);
-      if (!do_work_) { return nullptr; }
-      // search in loaded dll's
-      if (auto it = plugins_.find(nm); it != std::end(plugins_)) { return std::get<1>(it->second); }
-      #if (!defined(NDEBUG) || defined(DEBUG))
-      std::clog << "[microplugins] status of loading plugin '" << nm << "': ";
-      #endif
-      // try to load dll from system
-      std::shared_ptr<iplugin<>> ret = nullptr;
-      if (auto dll = std::make_shared<shared_library>(nm, path_); dll && dll->is_loaded()) {
-        if (auto loader = dll->get<import_plugin_cb_t>("import_plugin"); loader) {
-          if (auto ii = dll->get<std::shared_ptr<micro::iinfo>()>("import_plugin"); ii && ii() && ii()->type_info() == type_info() && (ret = loader())) {
-            ret->plugins_ = get_shared_ptr();
-            plugins_[nm] = {dll, ret};
-            std::thread(&plugins<>::service_plugin_cb, plugins<>::shared_from_this(), ret).detach();
-            #if (!defined(NDEBUG) || defined(DEBUG))
-            std::clog << "success" << std::endl;
-            #endif
-          }
-        }
-      }
-      if (!ret) {
-        #if (!defined(NDEBUG) || defined(DEBUG))
-        std::clog << "fail" << std::endl;
-        #endif
-      } return ret;
+      std::shared_ptr<iplugin<>> ret;
+      std::shared_ptr<loading> l;
+      if (find_or_join(nm, ret, l)) { return ret; }
+      complete(nm, *l);
+      return l->result.get();
+    }
+
+    /**
+      \returns Future for shared pointer to plugin (nullptr if it can not be loaded), loaded plugin is ready at once.
+      Plugin is loaded without lock of kernel by own thread of kernel for loading (or by concurrent caller of get_plugin(const std::string& nm), which comes first),
+      so search, dlopen() and import_plugin() do not occupy workers of tasks. Concurrent callers for the same plugin get one loading.
+      \param[in] nm name of plugin \see get_plugin(const std::string& nm)
+
+      \code
+      kernel->get_plugin_async("plugin1").then([](const std::shared_ptr<micro::iplugin<>>& p) { if (p) { p->run<0>("test0"); } });
+      \endcode
+    */
+    future<std::shared_ptr<iplugin<>>> get_plugin_async(const std::string& nm) override {
+      std::shared_ptr<iplugin<>> ret;
+      std::shared_ptr<loading> l;
+      if (find_or_join(nm, ret, l)) { return make_ready_future(std::move(ret)); }
+      if (!l->claimed) { loader()->post([k = plugins<>::shared_from_this(), nm, l]() { k->complete(nm, *l); }); }
+      return l->result;
+    }
+
+    /** \returns Loaded plugins in this moment, they are called without lock of kernel. \see iplugins::broadcast(const T& nm, const Args&... args) */
+    std::map<std::string, std::shared_ptr<iplugin<>>> loaded_plugins() const override {
+      std::map<std::string, std::shared_ptr<iplugin<>>> ret;
+      std::shared_lock<std::shared_mutex> lock(storage<>::mtx_);
+      if (!do_work_) { return ret; }
+      for (const auto& p : plugins_) { ret.emplace(p.first, std::get<1>(p.second)); }
+      return ret;
     }
 
     /** \returns Shared pointer to plugin. \param[in] i index of plugin \see count_plugins(), iplugins::get_plugin(int i) */
@@ -250,54 +515,228 @@ namespace micro {
       } return nullptr;
     }
 
-    /** Unloads plugin. \param[in] nm name of plugin */
-    void unload_plugin(const std::string& nm) noexcept {
-      std::unique_lock<std::shared_mutex> lock(storage<>::mtx_);
-      if (!do_work_) { return; }
-      if (auto it = plugins_.find(nm); it != std::end(plugins_)) {
-        if (std::get<1>(it->second)->do_work_) { std::get<1>(it->second)->do_work_ = false; }
-        while (std::get<1>(it->second).use_count() > 1) {
-          #if (!defined(NDEBUG) || defined(DEBUG))
-          std::clog << "[microplugins] wait termination plugin: '" << nm << "'" << std::endl;
-          #endif
-          micro::sleep<micro::seconds>(1);
-        } plugins_.erase(it);
-      }
+    /** Unloads plugin, it returns after plugin is retired. \param[in] nm name of plugin \see unload_plugin(const std::string& nm, const std::chrono::duration<Rep, Period>& timeout) */
+    void unload_plugin(const std::string& nm) noexcept { if (auto r = detach(nm); r.valid()) { r.wait(); } }
+
+    /**
+      \returns True if plugin was unloaded (its library is released) before timeout expired or it was not loaded.
+      Plugin is removed from kernel at once and its service is stopped, then its last user retires it after calls of plugin in flight have returned
+      (see storage::in_flight()). The caller is woken by retirement, kernel is not locked meanwhile. Plugin stays removed after timeout and it is retired later.
+      Plugin must not wait for own unloading (its call would wait for itself). \param[in] nm name of plugin \param[in] timeout time of waiting for retirement
+
+      \code
+      if (!kernel->unload_plugin("plugin1", std::chrono::milliseconds(200))) { std::clog << "plugin1 is still in use" << std::endl; }
+      \endcode
+    */
+    template<typename Rep, typename Period>
+    bool unload_plugin(const std::string& nm, const std::chrono::duration<Rep, Period>& timeout) noexcept {
+      future<bool> r = detach(nm);
+      return !r.valid() || r.wait_for(timeout) == std::future_status::ready;
     }
 
-    /** Unloads plugin. \param[in] i index of plugin \see count_plugins() */
-    void unload_plugin(std::size_t i) noexcept {
+    /** Unloads plugin, it returns after plugin is retired. \param[in] i index of plugin \see count_plugins(), unload_plugin(const std::string& nm) */
+    void unload_plugin(std::size_t i) noexcept { if (auto r = detach(i); r.valid()) { r.wait(); } }
+
+  private:
+
+    // true if plugin is loaded (ret), it is missing or kernel is stopped (nullptr), else l is loading in flight or new one
+    bool find_or_join(const std::string& nm, std::shared_ptr<iplugin<>>& ret, std::shared_ptr<loading>& l) {
+      {
+        std::shared_lock<std::shared_mutex> lock(storage<>::mtx_);
+        if (!do_work_) { return true; }
+        if (auto it = plugins_.find(nm); it != std::end(plugins_)) { ret = std::get<1>(it->second); return true; }
+      }
+      if (is_missing(nm)) { return true; }
       std::unique_lock<std::shared_mutex> lock(storage<>::mtx_);
-      if (do_work_ && i < std::size(plugins_)) {
-        for (auto it = std::begin(plugins_); it != std::end(plugins_); ++it) {
-          if (!i--) {
-            if (std::get<1>(it->second)->do_work_) { std::get<1>(it->second)->do_work_ = false; }
-            while (std::get<1>(it->second).use_count() > 1) {
-              #if (!defined(NDEBUG) || defined(DEBUG))
-              std::clog << "[microplugins] wait termination plugin: '" << std::get<1>(it->second)->name() << "'" << std::endl;
-              #endif
-              micro::sleep<micro::seconds>(1);
-            } plugins_.erase(it);
-            break;
-          }
+      if (!do_work_) { return true; }
+      if (auto it = plugins_.find(nm); it != std::end(plugins_)) { ret = std::get<1>(it->second); return true; }
+      if (auto it = loading_.find(nm); it != std::end(loading_)) { l = it->second; return false; }
+      loading_.emplace(nm, l = std::make_shared<loading>());
+      return false;
+    }
+
+    // executor of asynchronous loading, loading blocks (it must not occupy workers of pool)
+    std::shared_ptr<dedicated_thread> loader() {
+      std::unique_lock<std::mutex> lock(loader_mtx_);
+      if (!loader_) { loader_ = std::make_shared<dedicated_thread>(); }
+      return loader_;
+    }
+
+    // loads plugin, if loading was not claimed by other caller
+    void complete(const std::string& nm, loading& l) noexcept {
+      if (!l.claim()) { return; }
+      try { l.done.set_value(load(nm)); }
+      catch (...) { l.done.set_exception(std::current_exception()); }
+    }
+
+    // loads library of plugin by index, names of files (they are not indexed) are searched in directories
+    bool open(shared_library& dll, const std::string& nm) const {
+      if (!plugin_index::is_indexable(nm)) { return dll.load(nm, path_); }
+      for (const auto& e : index_->find(nm)) {
+        if (dll.load_file(e.filename)) { return true; }
+      } return false;
+    }
+
+    // loads plugin without lock of kernel (lookup, dlopen and import_plugin()), then registers it
+    std::shared_ptr<iplugin<>> load(const std::string& nm) {
+      std::shared_ptr<iplugin<>> ret = nullptr;
+      std::shared_ptr<shared_library> dll = nullptr;
+      plugin_index::stamp_t stamp;
+      try {
+        dll = std::make_shared<shared_library>();
+        if (!open(*dll, nm) && !watched_) { // changes of watched directories are reported by watcher
+          stamp = index_->stamp(); // before refresh, so changes while refreshing invalidate the failed lookup
+          if (index_->is_stale(stamp)) { index_->refresh(); open(*dll, nm); }
         }
+        if (dll->is_loaded()) { ret = import(*dll); }
+      } catch (...) { ret = nullptr; }
+      if (!ret) { missing(nm, (std::empty(stamp) && !watched_) ? index_->stamp() : std::move(stamp)); }
+      std::unique_lock<std::shared_mutex> lock(storage<>::mtx_);
+      loading_.erase(nm);
+      #if (!defined(NDEBUG) || defined(DEBUG))
+      std::clog << "[microplugins] status of loading plugin '" << nm << "': " << ((ret && do_work_) ? "success" : "fail") << std::endl;
+      #endif
+      if (!ret || !do_work_) { ret = nullptr; return nullptr; } // instance is released before its library (kernel can be stopped while loading)
+      if (auto it = plugins_.find(nm); it != std::end(plugins_)) { ret = nullptr; return std::get<1>(it->second); } // swapped meanwhile
+      return attach(nm, dll, ret, dll->filename());
+    }
+
+    // instance of plugin from library, nullptr if library is not plugin of this kernel
+    std::shared_ptr<iplugin<>> import(shared_library& dll) const {
+      std::shared_ptr<iplugin<>> ret = nullptr;
+      if (auto loader = dll.get<import_plugin_cb_t>("import_plugin"); loader) {
+        if (auto ii = dll.get<std::shared_ptr<micro::iinfo>()>("import_plugin"); !ii || !ii() || ii()->type_info() != type_info() || !(ret = loader())) { ret = nullptr; }
+      } return ret;
+    }
+
+    // loads own copy of library, so dlopen() does not return library loaded already by the same file
+    static bool open_copy(shared_library& dll, const std::string& fl) {
+      static std::atomic<std::size_t> n(0);
+      std::error_code ec;
+      std_filesystem::path src(fl), tmp = std_filesystem::temp_directory_path(ec);
+      if (ec) { return false; }
+      tmp /= "microplugins-" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()) + "-" + std::to_string(n++) + "-" + src.filename().generic_string();
+      if (!std_filesystem::copy_file(src, tmp, ec)) { return false; }
+      bool ret = dll.load_file(tmp.generic_string(), swap_flags);
+      std_filesystem::remove(tmp, ec); // library stays mapped (on Windows copy stays until it is unloaded)
+      return ret;
+    }
+
+    // registers loaded plugin and starts its service (mtx_ must be locked), returns plugin handed out by kernel
+    std::shared_ptr<iplugin<>> attach(const std::string& nm, const std::shared_ptr<shared_library>& dll, const std::shared_ptr<iplugin<>>& pl, const std::string& file) {
+      pl->plugins_ = get_shared_ptr();
+      pl->parent_ = this; // plugin without own executor uses executor of kernel, its calls are counted
+      pl->freeze(); // plugin has subscribed its tasks in constructor
+      promise<bool> retired;
+      std::shared_ptr<iplugin<>> ret = lease(dll, pl, retired);
+      plugins_[nm] = {dll, ret, file, retired.get_future()};
+      if (ret->has<1>("service")) { // it is marked before plugin can be released, so release() stops service which thread has not started yet
+        ret->do_work_ = true;
+        helpers::spawn(helpers_, [ret]() { service_plugin_cb(ret); });
       }
+      return ret;
     }
 
-  private:
+    // plugin handed out by kernel: its last user retires it by helper thread (it can be released by code of its library), then retired is set
+    std::shared_ptr<iplugin<>> lease(std::shared_ptr<shared_library> dll, std::shared_ptr<iplugin<>> pl, promise<bool> retired) {
+      iplugin<>* raw = pl.get();
+      return std::shared_ptr<iplugin<>>(raw, [dll = std::move(dll), pl = std::move(pl), retired = std::move(retired), h = helpers_](iplugin<>*) mutable {
+        // helpers outlive kernel, so plugin released after kernel is retired too
+        helpers::spawn(h, [dll = std::move(dll), pl = std::move(pl), retired = std::move(retired)]() mutable {
+          pl->state_->expire(); // resolved tasks do not start new calls
+          pl->state_->wait(); // calls started by released users
+          pl->drop_caches(); // cached results can be objects of code of plugin
+          pl.reset(); // instance is released before its library
+          dll.reset();
+          retired.set_value(true);
+        });
+      });
+    }
+
+    // removes plugin from kernel, returns future of its retirement (invalid if plugin was not loaded)
+    future<bool> detach(const std::string& nm) noexcept {
+      typename decltype(plugins_)::mapped_type p;
+      {
+        std::unique_lock<std::shared_mutex> lock(storage<>::mtx_);
+        auto it = plugins_.find(nm);
+        if (!do_work_ || it == std::end(plugins_)) { return {}; }
+        p = std::move(it->second);
+        plugins_.erase(it);
+      } return release(p); // plugin of kernel is released without lock
+    }
 
-    void service_plugin_cb(std::shared_ptr<iplugin<>> pl) {
-      if (!pl->has<1>("service")) { return; }
-      std::shared_future<std::any> r;
-      pl->do_work_ = true;
-      r = std::get<1>(pl->tasks_)["service"].run_once(std::make_any<std::shared_ptr<iplugin<>>>(pl));
+    // removes plugin from kernel by index, returns future of its retirement (invalid if plugin was not loaded)
+    future<bool> detach(std::size_t i) noexcept {
+      typename decltype(plugins_)::mapped_type p;
+      {
+        std::unique_lock<std::shared_mutex> lock(storage<>::mtx_);
+        if (!do_work_ || i >= std::size(plugins_)) { return {}; }
+        auto it = std::next(std::begin(plugins_), std::ptrdiff_t(i));
+        p = std::move(it->second);
+        plugins_.erase(it);
+      } return release(p);
+    }
+
+    // stops service of removed plugin, it is retired by its last user (kernel releases own plugin after it)
+    future<bool> release(const typename decltype(plugins_)::mapped_type& p) noexcept {
+      std::get<1>(p)->do_work_ = false;
+      return std::get<3>(p);
+    }
+
+    // remembers failed lookup, lookups of other state of search directories are forgotten
+    void missing(const std::string& nm, plugin_index::stamp_t&& stamp) {
+      std::unique_lock<std::mutex> lock(miss_mtx_);
+      if (!miss_ttl_.count()) { return; }
+      if (!watched_ && stamp != dirs_stamp_) { missing_.clear(); dirs_stamp_ = std::move(stamp); }
+      dirs_checked_ = std::chrono::steady_clock::now();
+      missing_[nm] = dirs_checked_ + miss_ttl_;
+    }
+
+    // true if lookup of plugin failed recently and search directories were not changed since
+    bool is_missing(const std::string& nm) {
+      std::unique_lock<std::mutex> lock(miss_mtx_);
+      auto it = missing_.find(nm);
+      if (it == std::end(missing_)) { return false; }
+      auto t = std::chrono::steady_clock::now();
+      if (it->second <= t) { missing_.erase(it); return false; }
+      if (!watched_ && t - dirs_checked_ >= std::chrono::seconds(1)) {
+        dirs_checked_ = t;
+        if (index_->stamp() != dirs_stamp_) { missing_.clear(); return false; }
+      } return true;
+    }
+
+    // changes of files in search directories (by watcher): index is refreshed, negative lookups are forgotten, changed plugins are swapped
+    void changed(const std::vector<std::string>& files) {
+      if (std::none_of(std::begin(files), std::end(files), [](const std::string& f) {
+        return !std::empty(f) && (f.back() == '/' || !std::empty(plugin_index::names(std_filesystem::path(f).filename().generic_string())));
+      })) { return; }
+      index_->refresh();
+      forget_missing();
+      if (!reload_) { return; }
+      std::vector<std::string> nms;
+      {
+        std::shared_lock<std::shared_mutex> lock(storage<>::mtx_);
+        if (!do_work_) { return; }
+        for (const auto& p : plugins_) {
+          if (std::find(std::begin(files), std::end(files), std::get<2>(p.second)) != std::end(files)) { nms.push_back(p.first); }
+        }
+      }
+      // watcher must not wait for swapping (and kernel must not be released by its thread), kernel can be in destruction
+      for (const auto& nm : nms) {
+        helpers::spawn(helpers_, [w = plugins<>::weak_from_this(), nm]() { if (auto k = w.lock(); k) { k->swap_plugin(nm); } });
+      }
+    }
+
+    static void service_plugin_cb(std::shared_ptr<iplugin<>> pl) {
+      future<std::any> r;
+      r = pl->run_once<1>("service", std::make_any<std::shared_ptr<iplugin<>>>(pl));
       r.wait();
     }
 
     void service_cb(std::shared_ptr<plugins<>> k) {
       if (!k->has<1>("service")) { return; }
-      std::shared_future<std::any> r;
-      r = std::get<1>(k->tasks_)["service"].run_once(std::make_any<std::shared_ptr<plugins<>>>(k));
+      future<std::any> r;
+      r = k->run_once<1>("service", std::make_any<std::shared_ptr<plugins<>>>(k));
       r.wait();
       if (r.valid() && r.get().has_value() && r.get().type() == typeid(int)) {
         k->error_ = std::any_cast<int>(r.get());
@@ -305,37 +744,43 @@ namespace micro {
     }
 
     void loop_cb(std::shared_ptr<plugins<>> k) noexcept {
-      micro::clock_t last_check = micro::now();
-      while (k->do_work_) {
-        if (micro::duration<micro::milliseconds>(last_check, micro::now()) >= 500) {
-          last_check = micro::now();
-          if (!k->max_idle_) { continue; }
+      std::unique_lock<std::mutex> loop(k->loop_mtx_);
+      // it wakes every 500 ms, stop() wakes it at once
+      while (!k->loop_cv_.wait_for(loop, std::chrono::milliseconds(500), [&k]() { return !k->do_work_; })) {
+        if (!k->max_idle_) { continue; }
+        loop.unlock();
+        {
           // unload plugin which has idle more or equal than `max_idle_' minutes
           // and the plugin is not service (has no task with name `service' in tasks_<1>)
           std::unique_lock<std::shared_mutex> lock(k->mtx_);
-          for (auto it = std::begin(k->plugins_); it != std::end(k->plugins_); ++it) {
+          for (auto it = std::begin(k->plugins_); it != std::end(k->plugins_);) {
             if (std::get<1>(it->second)->idle() >= k->max_idle_ && !std::get<1>(it->second)->has<1>("service")) {
               #if (!defined(NDEBUG) || defined(DEBUG))
               std::clog << "[microplugins] unloading plugin '" << std::get<1>(it->second)->name() << "' by achieving max idle time." << std::endl;
               #endif
-              k->plugins_.erase(it++);
-            }
+              it = k->plugins_.erase(it); // its last user retires it
+            } else { ++it; }
           }
-        } micro::sleep<micro::milliseconds>(100);
-      } k->expiry_ = true;
+        }
+        loop.lock();
+      }
+      k->expiry_ = true;
+      k->loop_cv_.notify_all();
     }
 
-    void unload_plugins() noexcept {
-      while (!std::empty(plugins_)) {
-        for (auto it = std::begin(plugins_); it != std::end(plugins_); ++it) {
-          if (std::get<1>(it->second)->do_work_) { std::get<1>(it->second)->do_work_ = false; }
-          if (std::get<1>(it->second).use_count() > 1) {
-            #if (!defined(NDEBUG) || defined(DEBUG))
-            std::clog << "[microplugins] wait termination plugin: '" << std::get<1>(it->second)->name() << "'" << std::endl;
-            #endif
-          } else { plugins_.erase(it++); }
-        } if (!std::empty(plugins_)) { micro::sleep<micro::seconds>(1); }
+    // unloads all plugins (kernel is stopped): they are removed at once, then their retirements are awaited without lock until deadline, false - some are not retired
+    bool unload_plugins(std::chrono::steady_clock::time_point deadline) noexcept {
+      decltype(plugins_) ps;
+      {
+        std::unique_lock<std::shared_mutex> lock(storage<>::mtx_);
+        ps.swap(plugins_);
       }
+      std::vector<future<bool>> rs;
+      for (const auto& p : ps) { rs.push_back(release(p.second)); }
+      ps.clear();
+      for (const auto& r : rs) {
+        if (r.wait_for(deadline - std::chrono::steady_clock::now()) != std::future_status::ready) { return false; }
+      } return true;
     }
 
   };
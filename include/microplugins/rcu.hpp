@@ -0,0 +1,211 @@
+/** \file rcu.hpp */
+#ifndef RCU_HPP_INCLUDED
+#define RCU_HPP_INCLUDED
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace micro {
+
+  /**
+    \class rcu_domain
+    \brief Readers of read-copy-update snapshots
+    \copyright Boost Software License - Version 1.0
+
+    Readers take no lock: each reader marks itself in a counter of own slot (slots are spreaded by threads
+    over separate cachelines), so readers of different threads do not touch shared cachelines.
+    Readers enter into slots of current epoch. Epoch is flipped only when readers of previous epoch have gone,
+    so readers, which have entered before flip, are in previous epoch and they are gone before the next flip.
+    Writer waits by synchronize() for readers, which have entered before it, or it checks them without waiting by try_flip().
+
+    \see rcu
+  */
+  class rcu_domain final {
+  private:
+
+    static constexpr std::size_t slots_count = 32;
+
+    struct alignas(64) slot { std::atomic<std::size_t> readers{0}; };
+
+    std::atomic<std::size_t> epoch_;
+    mutable slot slots_[2][slots_count];
+
+    static std::size_t index() noexcept {
+      static std::atomic<std::size_t> next(0);
+      static thread_local std::size_t i = next++ % slots_count;
+      return i;
+    }
+
+  public:
+
+    /**
+      \class reader
+      \brief Read-side section, it must be short-lived
+    */
+    class reader final {
+    private:
+
+      const rcu_domain* owner_;
+      std::size_t epoch_, slot_;
+
+    public:
+
+      /** Creates reader outside of any read-side section. */
+      reader() noexcept:owner_(nullptr),epoch_(0),slot_(0) {}
+
+      /** Enters into read-side section. \param[in] d domain */
+      explicit reader(const rcu_domain& d) noexcept:owner_(&d),epoch_(0),slot_(index()) {
+        while (true) {
+          epoch_ = owner_->epoch_.load() & 1;
+          owner_->slots_[epoch_][slot_].readers.fetch_add(1);
+          if ((owner_->epoch_.load() & 1) == epoch_) { break; }
+          owner_->slots_[epoch_][slot_].readers.fetch_sub(1);
+        }
+      }
+
+      reader(const reader& rhs) = delete;
+
+      /** Moves read-side section. \param[in] rhs reader for moving */
+      reader(reader&& rhs) noexcept:owner_(rhs.owner_),epoch_(rhs.epoch_),slot_(rhs.slot_) { rhs.owner_ = nullptr; }
+
+      /** Leaves read-side section. */
+      ~reader() {
+        if (owner_) { owner_->slots_[epoch_][slot_].readers.fetch_sub(1, std::memory_order_release); }
+      }
+
+      reader& operator=(const reader& rhs) = delete;
+
+    };
+
+    /** Creates domain. */
+    rcu_domain():epoch_(0),slots_() {}
+
+    rcu_domain(const rcu_domain& rhs) = delete;
+
+    ~rcu_domain() {}
+
+    /** \returns Read-side section for the calling thread. */
+    inline reader lock() const noexcept { return reader(*this); }
+
+    /**
+      \returns True if epoch was flipped: readers of previous epoch have gone, readers of current epoch are in previous one now.
+      Writers must be serialized by caller.
+    */
+    bool try_flip() noexcept {
+      std::size_t e = epoch_.load();
+      // loads are sequentially consistent, so they are ordered after publishing of snapshot against increments of readers
+      for (std::size_t i = 0; i < slots_count; ++i) {
+        if (slots_[(e + 1) & 1][i].readers.load()) { return false; }
+      }
+      epoch_.store(e + 1);
+      return true;
+    }
+
+    /** Waits for readers, which have entered before this call (two flips), it must not be called inside read-side section of this domain. */
+    void synchronize() noexcept {
+      for (int i = 0; i < 2; ++i) {
+        while (!try_flip()) { std::this_thread::yield(); }
+      }
+    }
+
+    rcu_domain& operator=(const rcu_domain& rhs) = delete;
+
+  };
+
+  /**
+    \class rcu
+    \brief Read-copy-update holder of immutable snapshot
+    \copyright Boost Software License - Version 1.0
+
+    Writer prepares new snapshot, publishes it by atomic swap of pointer and deletes previous snapshot
+    after all readers, which could see it, have gone (grace period). Writers must be serialized by caller.
+
+    Writer does not wait for readers: previous snapshot is deleted at once when nobody could see it, otherwise it is deferred
+    and deleted by one of next writers (after two flips of epoch, see rcu_domain::try_flip()) or by destructor.
+    So readers can keep snapshot while they work with it (e.g. while they call tasks) and writer can be a reader itself.
+
+    \code
+    micro::rcu<std::map<std::string,int>> m(std::make_unique<std::map<std::string,int>>());
+
+    if (auto r = m.read(); r->count("one")) { std::cout << r->at("one") << std::endl; } // reader
+
+    auto copy = std::make_unique<std::map<std::string,int>>(*m.read()); // writer
+    (*copy)["one"] = 1;
+    m.publish(std::move(copy));
+    \endcode
+  */
+  template<typename T>
+  class rcu final {
+  private:
+
+    std::shared_ptr<rcu_domain> domain_; // it can be shared with other holders and it can outlive holder
+    std::atomic<T*> ptr_;
+    std::vector<std::unique_ptr<T>> retired_; // retired after the last flip, their readers can be in both epochs
+    std::vector<std::unique_ptr<T>> waiting_; // retired before the last flip, their readers are in previous epoch
+
+  public:
+
+    /**
+      \class reader
+      \brief Read access to snapshot, snapshot is alive while reader exists
+    */
+    class reader final {
+    private:
+
+      rcu_domain::reader lock_;
+      T* ptr_;
+
+    public:
+
+      /** Enters into read-side section. \param[in] r holder of snapshot */
+      explicit reader(const rcu<T>& r) noexcept:lock_(*r.domain_),ptr_(r.ptr_.load()) {}
+
+      /** \returns Pointer to snapshot. */
+      inline T* get() const noexcept { return ptr_; }
+
+      /** \returns Pointer to snapshot. */
+      inline T* operator->() const noexcept { return ptr_; }
+
+      /** \returns Reference to snapshot. */
+      inline T& operator*() const noexcept { return *ptr_; }
+
+    };
+
+    /** Creates holder. \param[in] p first snapshot \param[in] d domain of readers */
+    explicit rcu(std::unique_ptr<T> p, std::shared_ptr<rcu_domain> d = std::make_shared<rcu_domain>()):domain_(std::move(d)),ptr_(p.release()),retired_(),waiting_() {}
+
+    rcu(const rcu& rhs) = delete;
+
+    ~rcu() { delete ptr_.load(); }
+
+    /** \returns Domain of readers of this holder. */
+    inline const rcu_domain& domain() const noexcept { return *domain_; }
+
+    /** \returns Reader of current snapshot. */
+    inline reader read() const noexcept { return reader(*this); }
+
+    /** Publishes new snapshot and deletes previous one after grace period. \param[in] p new snapshot \see exchange(std::unique_ptr<T> p), retire(std::unique_ptr<T> p) */
+    void publish(std::unique_ptr<T> p) { retire(exchange(std::move(p))); }
+
+    /** \returns Previous snapshot, it can be still in use by readers. \param[in] p new snapshot \see retire(std::unique_ptr<T> p) */
+    std::unique_ptr<T> exchange(std::unique_ptr<T> p) noexcept { return std::unique_ptr<T>(ptr_.exchange(p.release())); }
+
+    /** Deletes previous snapshot after grace period, writer does not wait for readers. \param[in] p previous snapshot \see exchange(std::unique_ptr<T> p) */
+    void retire(std::unique_ptr<T> p) {
+      retired_.push_back(std::move(p));
+      // the first flip releases snapshots of previous epoch, the second one releases p, if nobody reads
+      for (int i = 0; i < 2 && domain_->try_flip(); ++i) {
+        waiting_.clear();
+        std::swap(waiting_, retired_);
+      }
+    }
+
+    rcu& operator=(const rcu& rhs) = delete;
+
+  };
+
+} // namespace micro
+
+#endif // RCU_HPP_INCLUDED
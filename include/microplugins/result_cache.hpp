@@ -0,0 +1,142 @@
+/** \file result_cache.hpp */
+#ifndef RESULT_CACHE_HPP_INCLUDED
+#define RESULT_CACHE_HPP_INCLUDED
+
+#include "any_keys.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <list>
+
+namespace micro {
+
+  /**
+    \class result_cache
+    \brief Memoized results of pure task with LRU eviction, budget of memory and time to live
+    \copyright Boost Software License - Version 1.0
+
+    Results are kept by arguments of calls (see any_keys), least recently used results are evicted when size of results
+    (arguments, value and bookkeeping, see any_keys::size(const std::any& a)) is over budget. Exceptions are not cached.
+
+    Results can be objects created by code of plugin, so cache is closed before plugin is unloaded (see close()).
+
+    \see storage::cache(const T& nm, std::size_t budget, const std::chrono::duration<Rep, Period>& ttl), task::cache()
+  */
+  class result_cache final {
+  public:
+
+    /** \class counters \brief Counters of cache */
+    struct counters {
+      std::size_t hits; ///< calls which got cached result
+      std::size_t misses; ///< calls which were executed
+      std::size_t evictions; ///< results removed by budget or by time to live
+      std::size_t entries; ///< cached results
+      std::size_t bytes; ///< size of cached results
+    };
+
+  private:
+
+    struct entry {
+      any_key key;
+      std::any value;
+      std::size_t bytes;
+      std::chrono::steady_clock::time_point expires;
+    };
+
+    static constexpr std::size_t overhead = sizeof(entry) + 4 * sizeof(void*); // node of list and of hash table
+
+    std::shared_ptr<const any_keys> keys_;
+    std::size_t budget_;
+    std::chrono::nanoseconds ttl_;
+    std::mutex mtx_;
+    std::list<entry> lru_; // the most recently used first
+    std::unordered_map<any_key, std::list<entry>::iterator, any_keys::hasher, any_keys::equal_to> index_;
+    std::size_t bytes_;
+    bool closed_;
+    std::atomic<std::size_t> hits_, misses_, evictions_;
+
+    void erase(std::list<entry>::iterator it) {
+      bytes_ -= it->bytes;
+      index_.erase(it->key);
+      lru_.erase(it);
+    }
+
+  public:
+
+    /** Creates cache. \param[in] keys types of arguments \param[in] budget size of results in bytes \param[in] ttl time to live, zero - unlimited */
+    template<typename Rep, typename Period>
+    result_cache(std::shared_ptr<const any_keys> keys, std::size_t budget, const std::chrono::duration<Rep, Period>& ttl):
+    keys_(keys),budget_(budget),ttl_(std::chrono::duration_cast<std::chrono::nanoseconds>(ttl)),mtx_(),lru_(),
+    index_(16, any_keys::hasher(), any_keys::equal_to{keys}),bytes_(0),closed_(false),hits_(0),misses_(0),evictions_(0) {}
+
+    result_cache(const result_cache& rhs) = delete;
+
+    /** \returns Registry of types of arguments. */
+    const std::shared_ptr<const any_keys>& keys() const noexcept { return keys_; }
+
+    /** \returns True if result for arguments is cached and alive, it is copied into v. \param[in] k arguments \param[out] v result */
+    bool get(const any_key& k, std::any& v) {
+      std::unique_lock<std::mutex> lock(mtx_);
+      if (auto it = index_.find(k); it != std::end(index_)) {
+        if (ttl_.count() && it->second->expires <= std::chrono::steady_clock::now()) { erase(it->second); ++evictions_; }
+        else {
+          lru_.splice(std::begin(lru_), lru_, it->second);
+          v = it->second->value;
+          ++hits_;
+          return true;
+        }
+      }
+      ++misses_;
+      return false;
+    }
+
+    /** Caches result for arguments, least recently used results are evicted while cache is over budget. \param[in] k arguments \param[in] v result */
+    void put(const any_key& k, const std::any& v) {
+      std::size_t bytes = overhead + keys_->size(v);
+      for (const auto& a : k.args) { bytes += keys_->size(a); }
+      if (bytes > budget_) { return; }
+      std::unique_lock<std::mutex> lock(mtx_);
+      if (closed_) { return; }
+      if (auto it = index_.find(k); it != std::end(index_)) { erase(it->second); }
+      lru_.push_front(entry{k, v, bytes, std::chrono::steady_clock::now() + ttl_});
+      index_.emplace(k, std::begin(lru_));
+      bytes_ += bytes;
+      while (bytes_ > budget_) { erase(std::prev(std::end(lru_))); ++evictions_; }
+    }
+
+    /** Removes all results. */
+    void clear() {
+      std::list<entry> dropped;
+      {
+        std::unique_lock<std::mutex> lock(mtx_);
+        index_.clear();
+        dropped.swap(lru_);
+        bytes_ = 0;
+      } // results are destroyed without lock
+    }
+
+    /** Removes all results, results of calls in flight are not cached anymore. */
+    void close() {
+      { std::unique_lock<std::mutex> lock(mtx_); closed_ = true; }
+      clear();
+    }
+
+    /** \returns Counters of cache. */
+    counters stats() {
+      std::unique_lock<std::mutex> lock(mtx_);
+      return counters{hits_.load(), misses_.load(), evictions_.load(), std::size(lru_), bytes_};
+    }
+
+    /** \returns Maximal size of results in bytes. */
+    std::size_t budget() const noexcept { return budget_; }
+
+    /** \returns Time to live of result, zero - unlimited. */
+    std::chrono::nanoseconds ttl() const noexcept { return ttl_; }
+
+    result_cache& operator=(const result_cache& rhs) = delete;
+
+  };
+
+} // namespace micro
+
+#endif // RESULT_CACHE_HPP_INCLUDED
@@ -100,6 +100,13 @@ namespace micro {
       return ((dll_ = load_dll(name_lib, path0, flags)) != nullptr);
     }
 
+    /** \returns True if dll was loaded, file is not searched. \param[in] fl file of library \param[in] flags flags for loading dll \see plugin_index */
+    bool load_file(const std::string& fl, int flags = RTLD_GLOBAL|RTLD_LAZY) noexcept {
+      unload();
+      if ((dll_ = dlopen(fl.c_str(), flags))) { filename_ = fl; }
+      return is_loaded();
+    }
+
     /** \returns True if dll has symbol. \param[in] s name of symbol/function/variable \see dlsym(void*, const char*) */
     bool has(const std::string& s) const noexcept { return (!dll_ || !dlsym(dll_, s.c_str())) ? false : true; }
 
@@ -114,21 +121,25 @@ namespace micro {
     /** \returns Raw pointer to symbol \param[in] s name of symbol \see dlsym(void*, const char*) */
     void* get_raw(const std::string& s) noexcept { return dll_ ? dlsym(dll_, s.c_str()) : nullptr; }
 
-    shared_library& operator=(const shared_library& rhs) = delete;
-
-  private:
-
-    void* load_dll(const std::string& _name_lib, const std::string& path0 = {}, int flags = RTLD_GLOBAL|RTLD_LAZY) noexcept {
-      void* ret = nullptr;
-      std::string name_lib = _name_lib, filter_str, filter_version, env_path = ".:lib:plugins:../lib:../plugins:../lib/plugins";
-      std::size_t npaths1 = 0, npaths2 = 0;
-      std::vector<std::string> paths, paths0 = explode(path0, ":"), paths2 = explode(std::getenv("PATH"), ":");
+    /**
+      \returns Directories for search dlls in order of search: paths0, default paths, $PATH/../lib and $PATH/../lib/paths0.
+      \param[in] path0 paths for search exploded by ':' \see load(const std::string& name_lib, const std::string& path0, int flags)
+    */
+    static std::vector<std::string> search_paths(const std::string& path0 = {}) noexcept {
+      std::string env_path = ".:lib:plugins:../lib:../plugins:../lib/plugins";
+      const char* env = std::getenv("PATH");
+      std::vector<std::string> ret, paths0 = explode(path0, ":"), paths2 = explode(env ? env : "", ":");
 
       if (!path0.empty()) { env_path = path0 + ":" + env_path; }
-      paths = explode(env_path, ":");
-      npaths1 = std::size(paths);
-      paths.insert(std::end(paths), std::begin(paths2), std::end(paths2));
-      npaths2 = std::size(paths);
+      for (const auto& p : explode(env_path, ":")) { ret.push_back(p + "/"); }
+
+      for (const auto& p : paths2) {
+        #ifndef _WIN32
+        ret.push_back(p + "/../lib/");
+        #else
+        ret.push_back(p + "/");
+        #endif
+      }
 
       for (std::size_t _i0 = 0; _i0 < std::size(paths0); ++_i0) {
         for (std::size_t _i2 = 0; _i2 < std::size(paths2); ++_i2) {
@@ -137,10 +148,25 @@ namespace micro {
           m += "../lib/";
           #endif
           m += paths0[_i0];
-          paths.push_back(m);
+          ret.push_back(m + "/");
         }
       }
 
+      for (auto& p : ret) {
+        for (char* c = std::data(p); c && *c; ++c) { if (*c == '\\') *c = '/'; }
+      }
+      return ret;
+    }
+
+    shared_library& operator=(const shared_library& rhs) = delete;
+
+  private:
+
+    void* load_dll(const std::string& _name_lib, const std::string& path0 = {}, int flags = RTLD_GLOBAL|RTLD_LAZY) noexcept {
+      void* ret = nullptr;
+      std::string name_lib = _name_lib, filter_str, filter_version;
+      std::vector<std::string> paths = search_paths(path0);
+
       filter_version = "[._\\-0-9]{0,12}";
       #if defined(_WIN32) // windows
       if (name_lib.find(".dll") == std::string::npos && name_lib.find(".DLL") == std::string::npos) {
@@ -159,14 +185,7 @@ namespace micro {
       const std::regex name_lib_filter(name_lib + filter_str);
       std::error_code ec;
 
-      for (std::size_t _i = 0; _i < std::size(paths); ++_i) {
-        std::string str_path = paths[_i] + "/";
-        #ifndef _WIN32
-        if (_i >= npaths1 && _i < npaths2) { str_path += "../lib/"; }
-        #endif
-
-        for (char* c = std::data(str_path); c && *c; ++c) { if (*c == '\\') *c = '/'; }
-
+      for (const auto& str_path : paths) {
         std_filesystem::path p(str_path);
         if (!std_filesystem::is_directory(p, ec)) { continue; }
         std_filesystem::directory_iterator dir_iter(p, ec), end_iter;
@@ -189,7 +208,7 @@ namespace micro {
       return ret;
     }
 
-    std::vector<std::string> explode(const std::string& str, const std::string& delims) noexcept {
+    static std::vector<std::string> explode(const std::string& str, const std::string& delims) noexcept {
       std::vector<std::string> paths;
       std::size_t s = str.find_first_not_of(delims), e = 0;
       while ((e = str.find_first_of(delims, s)) != std::string::npos) {
@@ -0,0 +1,79 @@
+/** \file single_flight.hpp */
+#ifndef SINGLE_FLIGHT_HPP_INCLUDED
+#define SINGLE_FLIGHT_HPP_INCLUDED
+
+#include "any_keys.hpp"
+#include "future.hpp"
+
+#include <atomic>
+#include <exception>
+
+namespace micro {
+
+  /**
+    \class single_flight
+    \brief Concurrent calls of task with equal arguments share one execution and one result
+    \copyright Boost Software License - Version 1.0
+
+    Call is in flight from its start until its result is ready, next calls with equal arguments get future of it.
+    Arguments are compared by any_keys of storage, calls with arguments of not registered types are executed as usually.
+
+    \see storage::single_flight(const T& nm, bool on), any_keys
+  */
+  template<typename... Ts>
+  class single_flight final : public std::enable_shared_from_this<single_flight<Ts...>> {
+  private:
+
+    std::shared_ptr<const any_keys> keys_;
+    std::mutex mtx_;
+    std::unordered_map<any_key, future<std::any>, any_keys::hasher, any_keys::equal_to> flights_;
+    std::atomic<std::size_t> shared_; // calls joined to calls in flight
+
+  public:
+
+    /** Creates empty set of calls in flight. \param[in] keys registry of types of arguments */
+    explicit single_flight(std::shared_ptr<const any_keys> keys):std::enable_shared_from_this<single_flight<Ts...>>(),
+    keys_(keys),mtx_(),flights_(16, any_keys::hasher(), any_keys::equal_to{keys}),shared_(0) {}
+
+    single_flight(const single_flight& rhs) = delete;
+
+    /**
+      \returns Future of call in flight with equal arguments or of new call started by f(std::move(args)).
+      \param[in] args arguments of call \param[in] f function future<std::any>(std::tuple<Ts...>&&), which starts call
+    */
+    template<typename F>
+    future<std::any> run(std::tuple<Ts...> args, F&& f) {
+      any_key k;
+      if (!keys_->make(args, k)) { return f(std::move(args)); }
+      promise<std::any> p;
+      {
+        std::unique_lock<std::mutex> lock(mtx_);
+        if (auto it = flights_.find(k); it != std::end(flights_)) { ++shared_; return it->second; }
+        flights_.emplace(k, p.get_future());
+      }
+      future<std::any> r;
+      try { r = f(std::move(args)); } catch (...) { p.set_exception(std::current_exception()); }
+      if (!r.valid() && !p.get_future().is_ready()) { p.set_value(std::any()); }
+      future<std::any> ret = p.get_future();
+      // key is removed after the result is set, so late callers with equal arguments start new call
+      ret.on_ready([self = this->shared_from_this(), k = std::move(k)]() {
+        std::unique_lock<std::mutex> lock(self->mtx_);
+        self->flights_.erase(k);
+      });
+      if (r.valid()) { r.forward_to(p); }
+      return ret;
+    }
+
+    /** \returns Amount of calls in flight. */
+    std::size_t size() noexcept { std::unique_lock<std::mutex> lock(mtx_); return std::size(flights_); }
+
+    /** \returns Amount of calls which got result of other call in flight. */
+    std::size_t shared() const noexcept { return shared_; }
+
+    single_flight& operator=(const single_flight& rhs) = delete;
+
+  };
+
+} // namespace micro
+
+#endif // SINGLE_FLIGHT_HPP_INCLUDED
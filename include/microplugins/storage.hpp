@@ -2,11 +2,16 @@
 #ifndef STORAGE_HPP_INCLUDED
 #define STORAGE_HPP_INCLUDED
 
+#include "coroutine.hpp"
 #include "iinfo.hpp"
+#include "rcu.hpp"
 #include "tasks.hpp"
 
+#include <condition_variable>
+#include <mutex>
 #include <shared_mutex>
 #include <tuple>
+#include <vector>
 
 namespace micro {
 
@@ -26,8 +31,20 @@ namespace micro {
 
     All tasks has returning and arguments type is std::any.
 
+    Typed tasks (subscribed with signature, e.g. subscribe<int(int,int)>("sum2", sum2)) are called by run<int(int,int)>("sum2", 1, 2)
+    without boxing of arguments and result; for untyped callers they are usual tasks with std::any.
+
     Maximum arguments for tasks is 6, minimum is 0.
 
+    Tasks are kept in immutable snapshot, which is replaced by subscribe/unsubscribe (see rcu),
+    so running of tasks and other readers take no lock. Tasks are started inside read-side section of snapshot,
+    so callers do not share ownership of tasks and executors.
+
+    Tasks are got by index, by name or by key of name with hash computed at compile time (see task_key).
+
+    Calls of plugin loaded by kernel (also by resolved tasks, see bind(const T& nm)) are counted until their results are ready (see in_flight()),
+    so kernel retires plugin right after its last call returns.
+
     You can change it for your needs by defining constant with cmake while configure:
 
     > ~/build $ cmake -DMAX_PLUGINS_ARGS=12 ../
@@ -40,10 +57,6 @@ namespace micro {
 
     template<std::size_t> friend class plugins;
 
-    mutable std::shared_mutex mtx_;
-    int version_;
-    std::string name_;
-
     template<typename T, std::size_t N, typename... Args>
     struct gen_tasks_type { using type = typename gen_tasks_type<T, N-1, T, Args...>::type; };
 
@@ -56,48 +69,109 @@ namespace micro {
     template<typename T, typename... Args>
     struct gen_storage_type<T, 0, Args...> { using type = std::tuple<typename gen_tasks_type<T, 0>::type, Args...>; };
 
-    typename gen_storage_type<std::any, L>::type tasks_;
+    // immutable snapshot of tasks, it is replaced entirely by writers
+    struct registry {
+      typename gen_storage_type<std::any, L>::type tasks;
+      std::shared_ptr<iexecutor> executor;
+      std::shared_ptr<adaptive_policy> adaptive;
+    };
+
+    mutable std::shared_mutex mtx_; // for writers of registry_ (and for plugins of kernel)
+    int version_;
+    std::string name_;
+    const storage<L>* parent_; // kernel of plugin, for executor by default
+    std::shared_ptr<tasks_state> state_; // generation of resolved tasks, readers of registry_ and calls of plugin (parent_ is set)
+    rcu<registry> registry_;
+    std::shared_ptr<any_keys> keys_; // hash and equality of arguments of tasks
 
   protected:
 
     /** Creates storage of tasks. \param[in] v version of storage \param[in] nm name of storage */
     explicit storage(int v = make_version(1,0), const std::string& nm = {}):iinfo(typeid(storage<L>)),
-    mtx_(),version_(v),name_(nm),tasks_() {
+    mtx_(),version_(v),name_(nm),parent_(nullptr),state_(std::make_shared<tasks_state>()),registry_(std::make_unique<registry>(), std::shared_ptr<rcu_domain>(state_, &state_->domain())),keys_(std::make_shared<any_keys>()) {
       static_assert(L > 0, "\n\nPlease, set up MAX_PLUGINS_ARGS constant as least to value 1 by: /path/to/build $ cmake -DMAX_PLUGINS_ARGS=12 ../ or what you need...\n");
     }
 
-    /** Adds task into storage for given number arguments in I. \param[in] nm name of task \param[in] t function/method/lambda \param[in] hlp message help for task */
+    /** Adds task into storage for given number arguments in I. \param[in] nm name of task \param[in] t function/method/lambda, function returning future<std::any> (e.g. coroutine) is asynchronous task \param[in] hlp message help for task \see task::async(const std::function<future<std::any>(Ts...)>& f) */
     template<std::size_t I, typename T>
     void subscribe(const std::string& nm, const T& t, const std::string& hlp = {}) {
       static_assert((L > 0 && I < L), "\n\nOut of range for valid number arguments of plugin's function. \nPlease, set it to larger value by: /path/to/build $ cmake -DMAX_PLUGINS_ARGS=12 ../ or what you need...\n");
       std::unique_lock<std::shared_mutex> lock(mtx_);
-      std::get<I>(tasks_).subscribe(nm, t, hlp);
+      if (std::get<I>(registry_.read()->tasks).has(nm)) { return; }
+      update([&](registry& r) {
+        if constexpr (std::tuple_element_t<I, decltype(registry::tasks)>::template is_async<T>) { std::get<I>(r.tasks).subscribe_async(nm, t, hlp); }
+        else { std::get<I>(r.tasks).subscribe(nm, t, hlp); }
+      }, false);
     }
 
-    /** Removes task from storage for given number arguments in I. \param[in] nm index or name of task */
+    /** Adds typed task into storage, untyped callers call it as task for given number arguments of S. \param[in] nm name of task \param[in] t function/method/lambda with signature S \param[in] hlp message help for task \see task::typed(const F& f), run(const T& nm, Args&&... args) */
+    template<typename S, typename T>
+    void subscribe(const std::string& nm, const T& t, const std::string& hlp = {}) {
+      constexpr std::size_t I = signature_traits<S>::arity;
+      static_assert((L > 0 && I < L), "\n\nOut of range for valid number arguments of plugin's function. \nPlease, set it to larger value by: /path/to/build $ cmake -DMAX_PLUGINS_ARGS=12 ../ or what you need...\n");
+      std::unique_lock<std::shared_mutex> lock(mtx_);
+      if (std::get<I>(registry_.read()->tasks).has(nm)) { return; }
+      update([&](registry& r) { std::get<I>(r.tasks).template subscribe<S>(nm, t, hlp); }, false);
+    }
+
+    /**
+      Adds batch handler for task with signature S = R(Args...), task is created if it does not exist (scalar callers call handler for one element).
+      \param[in] nm name of task \param[in] f function/method/lambda void(const Args*... args, R* results, std::size_t n) \param[in] hlp message help for new task
+      \see task::batch(const F& f), run_batch(const T& nm, R&& batch)
+    */
+    template<typename S, typename F>
+    void subscribe_batch(const std::string& nm, const F& f, const std::string& hlp = {}) {
+      constexpr std::size_t I = signature_traits<S>::arity;
+      static_assert((L > 0 && I < L), "\n\nOut of range for valid number arguments of plugin's function. \nPlease, set it to larger value by: /path/to/build $ cmake -DMAX_PLUGINS_ARGS=12 ../ or what you need...\n");
+      std::unique_lock<std::shared_mutex> lock(mtx_);
+      update([&](registry& r) { std::get<I>(r.tasks).template subscribe_batch<S>(nm, f, hlp); });
+    }
+
+    /** Removes task from storage for given number arguments in I. \param[in] nm index, name or key of task (see task_key) */
     template<std::size_t I, typename T>
     void unsubscribe(const T& nm) {
       std::unique_lock<std::shared_mutex> lock(mtx_);
       if constexpr (I < L) {
-        if (std::get<I>(tasks_)[nm].is_service() && std::get<I>(tasks_)[nm].is_once()) { return; }
-        else { std::get<I>(tasks_).unsubscribe(nm); }
+        if (auto r = registry_.read(); !std::get<I>(r->tasks).has(nm) || (std::get<I>(r->tasks)[nm].is_service() && std::get<I>(r->tasks)[nm].is_once())) { return; }
+        update([&](registry& r) { std::get<I>(r.tasks).unsubscribe(nm); });
       }
     }
 
-    /** Runs task once for given number arguments in I. \param[in] nm index or name of task \param[in] args arguments for task \returns Shared future for result \see std::shared_future, std::any, std::async */
+    /** Runs task once for given number arguments in I. \param[in] nm index, name or key of task (see task_key) \param[in] args arguments for task \returns Future for result \see future, std::any, executor(std::shared_ptr<iexecutor> e) */
     template<std::size_t I, typename T, typename... Args>
-    inline std::shared_future<std::any> run_once(const T& nm, Args&&... args) {
-      std::shared_lock<std::shared_mutex> lock(mtx_);
-      if constexpr (I < L) { return std::get<I>(tasks_)[nm].run_once(std::forward<Args>(args)...); }
-      else { return {}; }
+    inline future<std::any> run_once(const T& nm, Args&&... args) {
+      if constexpr (I < L) {
+        return counted([&]() { return resolve<I>(nm, [&](auto& t, iexecutor* e, adaptive_policy*) { return t.run_once_by(e, std::forward<Args>(args)...); }); });
+      } else { return {}; }
+    }
+
+    /** Runs typed task once without boxing of arguments and result. \param[in] nm index, name or key of task (see task_key) \param[in] args arguments for task \returns Future for result or empty future if task has other signature \see task::run_as(Args&&... args) */
+    template<typename S, typename T, typename... Args>
+    inline future<typename signature_traits<S>::result_type> run_once(const T& nm, Args&&... args) {
+      constexpr std::size_t I = signature_traits<S>::arity;
+      if constexpr (I < L) {
+        return counted([&]() { return resolve<I>(nm, [&](auto& t, iexecutor* e, adaptive_policy*) { return t.template run_once_as_by<S>(e, std::forward<Args>(args)...); }); });
+      } else { return {}; }
     }
 
     /** Clears once flag in all tasks of this container. \see clear_once_impl(T& tasks_) */
-    void clear_once() noexcept { clear_once_impl(tasks_); }
+    void clear_once() noexcept { clear_once_impl(registry_.read()->tasks); }
+
+    /** Drops cached results of all tasks of this container, kernel does it before plugin is unloaded (results can be objects of code of plugin). \see cache(const T& nm, std::size_t budget, const std::chrono::duration<Rep, Period>& ttl) */
+    void drop_caches() noexcept {
+      auto r = registry_.read();
+      std::apply([](auto&... ts) {
+        ([&ts]() { for (std::size_t i = 0; i < ts.count(); ++i) { if (const auto& c = ts[i].cache(); c) { c->close(); } } }(), ...);
+      }, r->tasks);
+    }
 
   public:
 
-    ~storage() override {}
+    /** Invalidates resolved tasks and waits for their calls, which are starting now (see task_handle). */
+    ~storage() override {
+      state_->expire();
+      state_->domain().synchronize();
+    }
 
     /** \returns Version of storage. */
     int version() const noexcept { return version_; }
@@ -114,67 +188,312 @@ namespace micro {
     /** \returns Maximum arguments for tasks of storage. */
     std::size_t max_args() const noexcept { return L; }
 
-    /** Runs task if it is not once-called for given number arguments in I. \param[in] nm index or name of task \param[in] args arguments for task \returns Shared future for result \see std::shared_future, std::any, std::async */
+    /** \returns Executor of storage or nullptr. \see executor(std::shared_ptr<iexecutor> e) */
+    std::shared_ptr<iexecutor> executor() const noexcept { return registry_.read()->executor; }
+
+    /** Sets executor for tasks of storage, which have no own executor. \param[in] e executor, nullptr - executor of kernel \see iexecutor, executor(const T& nm, std::shared_ptr<iexecutor> e, const iexecutor::hints& h) */
+    void executor(std::shared_ptr<iexecutor> e) noexcept {
+      std::unique_lock<std::shared_mutex> lock(mtx_);
+      update([&](registry& r) { r.executor = std::move(e); });
+    }
+
+    /** \returns Adaptive policy of storage or nullptr. \see adaptive(std::shared_ptr<adaptive_policy> a) */
+    std::shared_ptr<adaptive_policy> adaptive() const noexcept { return registry_.read()->adaptive; }
+
+    /** Sets policy, which runs short tasks inline and long ones by executor, for tasks of storage which have no own executor (plugins without own executor use policy of kernel). \param[in] a policy, nullptr - tasks are always executed by executor \see adaptive_policy, run(const T& nm, Args&&... args) */
+    void adaptive(std::shared_ptr<adaptive_policy> a) noexcept {
+      std::unique_lock<std::shared_mutex> lock(mtx_);
+      update([&](registry& r) { r.adaptive = std::move(a); });
+    }
+
+    /** Sets own executor for task for given number arguments in I. \param[in] nm index, name or key of task (see task_key) \param[in] e executor, nullptr - executor of storage \param[in] h hints for scheduling \see task::executor(std::shared_ptr<iexecutor> e, const iexecutor::hints& h) */
+    template<std::size_t I, typename T>
+    void executor(const T& nm, std::shared_ptr<iexecutor> e, const iexecutor::hints& h = {}) noexcept {
+      std::unique_lock<std::shared_mutex> lock(mtx_);
+      if constexpr (I < L) { update([&](registry& r) { std::get<I>(r.tasks).executor(nm, std::move(e), h); }); }
+    }
+
+    /**
+      Sets micro-batching for task with batch handler with signature S: concurrent calls are collected for window (or up to max_calls) and given to handler in one invocation.
+      \returns True if micro-batching was set or removed, false if task was not found or has no batch handler with signature S.
+      \param[in] nm index, name or key of task (see task_key) \param[in] window maximal time of collecting of batch, zero - removes micro-batching \param[in] max_calls maximal amount of calls in batch
+      \see task::micro_batch(const std::chrono::duration<Rep, Period>& window, std::size_t max_calls), subscribe_batch(const std::string& nm, const F& f, const std::string& hlp)
+
+      \code
+      plugin->micro_batch<double(double,double)>("add", std::chrono::microseconds(100), 256);
+      micro::future<double> r = plugin->run<double(double,double)>("add", 1.0, 2.0); // given to handler with other calls of 100 microseconds
+      \endcode
+    */
+    template<typename S, typename T, typename Rep, typename Period>
+    bool micro_batch(const T& nm, const std::chrono::duration<Rep, Period>& window, std::size_t max_calls) {
+      constexpr std::size_t I = signature_traits<S>::arity;
+      bool ret = false;
+      std::unique_lock<std::shared_mutex> lock(mtx_);
+      if constexpr (I < L) {
+        if (!std::get<I>(registry_.read()->tasks).has(nm)) { return false; }
+        update([&](registry& r) { ret = std::get<I>(r.tasks).template micro_batch<S>(nm, window, max_calls); });
+      }
+      return ret;
+    }
+
+    /** \returns Hash and equality of types of arguments of tasks, types are registered by any_keys::add(). \see single_flight(const T& nm, bool on) */
+    const std::shared_ptr<any_keys>& keys() const noexcept { return keys_; }
+
+    /**
+      Sets single-flight mode for task for given number arguments in I: concurrent calls by run with equal arguments share one execution and one result.
+      Arguments are compared by keys() (arithmetic types and std::string are registered), calls with arguments of other types are executed as usually.
+      \returns True if task was found. \param[in] nm index, name or key of task (see task_key) \param[in] on true - sets mode, false - removes it
+      \see single_flight, task::flights(std::shared_ptr<const any_keys> keys)
+
+      \code
+      plugin->keys()->add<point>(); // std::hash<point> and operator==
+      plugin->single_flight<1>("lookup");
+      auto a = plugin->run<1>("lookup", std::string("key")), b = plugin->run<1>("lookup", std::string("key")); // one execution, if a is not ready yet
+      \endcode
+    */
+    template<std::size_t I, typename T>
+    bool single_flight(const T& nm, bool on = true) {
+      std::unique_lock<std::shared_mutex> lock(mtx_);
+      if constexpr (I < L) {
+        if (!std::get<I>(registry_.read()->tasks).has(nm)) { return false; }
+        update([&](registry& r) { std::get<I>(r.tasks).flights(nm, on ? keys_ : nullptr); });
+        return true;
+      } else { return false; }
+    }
+
+    /**
+      Sets cache of results for pure task for given number arguments in I: calls by run and call with equal arguments (compared by keys()) get cached result.
+      Least recently used results are evicted by budget, results are expired by time to live; caches of plugin are dropped when it is unloaded.
+      \returns True if task was found. \param[in] nm index, name or key of task (see task_key) \param[in] budget maximal size of results in bytes, 0 - removes cache
+      \param[in] ttl time to live of result, zero - unlimited \see result_cache, cache(const T& nm)
+
+      \code
+      plugin->cache<1>("resolve", 1 << 20, std::chrono::seconds(30));
+      micro::result_cache::counters c = plugin->cache<1>("resolve")->stats(); // hits, misses, evictions, entries, bytes
+      \endcode
+    */
+    template<std::size_t I, typename T, typename Rep = std::int64_t, typename Period = std::nano>
+    bool cache(const T& nm, std::size_t budget, const std::chrono::duration<Rep, Period>& ttl = std::chrono::duration<Rep, Period>::zero()) {
+      std::unique_lock<std::shared_mutex> lock(mtx_);
+      if constexpr (I < L) {
+        auto r = registry_.read();
+        if (!std::get<I>(r->tasks).has(nm)) { return false; }
+        std::shared_ptr<result_cache> old = std::get<I>(r->tasks)[nm].cache(), c = budget ? std::make_shared<result_cache>(keys_, budget, ttl) : nullptr;
+        update([&](registry& rr) { std::get<I>(rr.tasks).cache(nm, c); });
+        if (old) { old->close(); }
+        return true;
+      } else { return false; }
+    }
+
+    /** \returns Cache of results of task for given number arguments in I or nullptr. \param[in] nm index, name or key of task (see task_key) \see cache(const T& nm, std::size_t budget, const std::chrono::duration<Rep, Period>& ttl) */
+    template<std::size_t I, typename T>
+    std::shared_ptr<result_cache> cache(const T& nm) const noexcept {
+      if constexpr (I < L) { return std::get<I>(registry_.read()->tasks)[nm].cache(); }
+      else { return nullptr; }
+    }
+
+    /** Rebuilds lookup of tasks as perfect hash, kernel does it for each loaded plugin. Next subscribing/unsubscribing rebuilds ordinary lookup. \see tasks::freeze() */
+    void freeze() {
+      std::unique_lock<std::shared_mutex> lock(mtx_);
+      update([](registry& r) { std::apply([](auto&... ts) { (ts.freeze(), ...); }, r.tasks); }, false);
+    }
+
+    /** \returns Resolved task for given number arguments in I, it is invalid if task was not found. \param[in] nm index, name or key of task (see task_key) \see task_handle */
+    template<std::size_t I, typename T>
+    inline typename std::tuple_element_t<I, decltype(registry::tasks)>::handle_type bind(const T& nm) const noexcept {
+      static_assert((L > 0 && I < L), "\n\nOut of range for valid number arguments of plugin's function. \nPlease, set it to larger value by: /path/to/build $ cmake -DMAX_PLUGINS_ARGS=12 ../ or what you need...\n");
+      using handle_type = typename std::tuple_element_t<I, decltype(registry::tasks)>::handle_type;
+      std::size_t g = state_->current(); // before snapshot, see update(F&& f, bool e)
+      auto r = registry_.read();
+      auto t = std::get<I>(r->tasks).lookup(nm);
+      if (!t) { return {}; }
+      else if (r->executor || !parent_) { return handle_type(t, r->executor.get(), r->adaptive.get(), state_, g, nullptr, 0, parent_ != nullptr); }
+      else {
+        std::size_t pg = parent_->state_->current();
+        auto p = parent_->registry_.read();
+        return handle_type(t, p->executor.get(), p->adaptive.get(), state_, g, parent_->state_, pg, true);
+      }
+    }
+
+    /** Runs task if it is not once-called for given number arguments in I. \param[in] nm index, name or key of task (see task_key) \param[in] args arguments for task \returns Future for result \see future, std::any, executor(std::shared_ptr<iexecutor> e), adaptive(std::shared_ptr<adaptive_policy> a) */
     template<std::size_t I, typename T, typename... Args>
-    inline std::shared_future<std::any> run(const T& nm, Args&&... args) {
-      std::shared_lock<std::shared_mutex> lock(mtx_);
-      if constexpr (I < L) { return std::get<I>(tasks_)[nm](std::forward<Args>(args)...); }
-      else { return {}; }
+    inline future<std::any> run(const T& nm, Args&&... args) {
+      if constexpr (I < L) {
+        return counted([&]() { return resolve<I>(nm, [&](auto& t, iexecutor* e, adaptive_policy* a) { return t.run_adaptive_by(e, a, std::forward<Args>(args)...); }); });
+      } else { return {}; }
+    }
+
+    /** Runs typed task without boxing of arguments and result. \param[in] nm index, name or key of task (see task_key) \param[in] args arguments for task \returns Future for result or empty future if task has other signature \see task::run_as(Args&&... args), subscribe(const std::string& nm, const T& t, const std::string& hlp) */
+    template<typename S, typename T, typename... Args>
+    inline future<typename signature_traits<S>::result_type> run(const T& nm, Args&&... args) {
+      constexpr std::size_t I = signature_traits<S>::arity;
+      if constexpr (I < L) {
+        return counted([&]() { return resolve<I>(nm, [&](auto& t, iexecutor* e, adaptive_policy*) { return t.template run_as_by<S>(e, std::forward<Args>(args)...); }); });
+      } else { return {}; }
+    }
+
+    /**
+      \returns Future for results of task called for each element of batch (in order of elements) or empty future if task was not found.
+      \param[in] nm index, name or key of task (see task_key) \param[in] batch range of tuples of arguments (single arguments for I == 1), it is copied or moved from rvalue std::vector
+
+      Task is found once and batch is partitioned across executor of task, see task::run_batch_by(iexecutor* e, std::shared_ptr<const std::vector<E>> batch).
+
+      \code
+      std::vector<std::tuple<int,int>> records = {{1, 2}, {3, 4}, {5, 6}};
+      micro::future<std::vector<std::any>> sums = plugin->run_batch<2>("sum2", records);
+      \endcode
+    */
+    template<std::size_t I, typename T, typename R>
+    inline future<std::vector<std::any>> run_batch(const T& nm, R&& batch) { return parallel_map<I>(nm, std::forward<R>(batch)); }
+
+    /**
+      \returns Future for typed results of task called for each element of batch or empty future if task was not found or can not be called with signature S.
+      \param[in] nm index, name or key of task (see task_key) \param[in] batch range of tuples of arguments (single arguments for task with one argument)
+
+      Batch handler of task is preferred (see subscribe_batch(const std::string& nm, const F& f, const std::string& hlp)), otherwise scalar task is called for each element.
+
+      \code
+      std::vector<std::pair<double,double>> points = ...;
+      micro::future<std::vector<double>> sums = plugin->run_batch<double(double,double)>("add", points);
+      \endcode
+    */
+    template<typename S, typename T, typename R>
+    inline future<std::vector<typename signature_traits<S>::result_type>> run_batch(const T& nm, R&& batch) { return parallel_map<S>(nm, std::forward<R>(batch)); }
+
+    /**
+      \returns Future for results of task called for each element of range (in order of elements) or empty future if task was not found.
+      \param[in] nm index, name or key of task (see task_key) \param[in] range elements (arguments for I == 1, tuples of arguments otherwise), it is copied or moved from rvalue std::vector
+      \param[in] grain elements in chunk, 0 - several chunks per thread of executor
+
+      Scatter-gather without future per element: range is split into chunks, jobs of executor (one per its thread) take next chunk while there are chunks,
+      results are written in place, one future is ready after the last chunk. Small grain balances uneven elements, large one has less overhead.
+      \see run_batch(const T& nm, R&& batch), task::run_batch_by(iexecutor* e, std::shared_ptr<const std::vector<E>> batch, std::size_t grain)
+
+      \code
+      std::vector<std::any> xs = ...;
+      micro::future<std::vector<std::any>> ys = plugin->parallel_map<1>("transform", std::move(xs));
+      \endcode
+    */
+    template<std::size_t I, typename T, typename R>
+    inline future<std::vector<std::any>> parallel_map(const T& nm, R&& range, std::size_t grain = 0) {
+      if constexpr (I < L) {
+        return counted([&]() {
+          return resolve<I>(nm, [&](auto& t, iexecutor* e, adaptive_policy*) { auto b = shared_range(std::forward<R>(range)); return t.run_batch_by(e, std::move(b), grain); });
+        });
+      } else { return {}; }
+    }
+
+    /**
+      \returns Future for typed results of task called for each element of range or empty future if task was not found or can not be called with signature S.
+      \param[in] nm index, name or key of task (see task_key) \param[in] range elements (arguments for task with one argument, tuples of arguments otherwise) \param[in] grain elements in chunk, 0 - several chunks per thread of executor
+      \see parallel_map(const T& nm, R&& range, std::size_t grain), run_batch(const T& nm, R&& batch)
+    */
+    template<typename S, typename T, typename R>
+    inline future<std::vector<typename signature_traits<S>::result_type>> parallel_map(const T& nm, R&& range, std::size_t grain = 0) {
+      constexpr std::size_t I = signature_traits<S>::arity;
+      if constexpr (I < L) {
+        return counted([&]() {
+          return resolve<I>(nm, [&](auto& t, iexecutor* e, adaptive_policy*) { auto b = shared_range(std::forward<R>(range)); return t.template run_batch_as_by<S>(e, std::move(b), grain); });
+        });
+      } else { return {}; }
     }
 
+    /** \returns True if storage has batch handler with signature S. \param[in] nm index, name or key of task (see task_key) */
+    template<typename S, typename T>
+    inline bool has_batch(const T& nm) const noexcept {
+      constexpr std::size_t I = signature_traits<S>::arity;
+      if constexpr (I < L) { return std::get<I>(registry_.read()->tasks)[nm].template has_batch<S>(); }
+      else { return false; }
+    }
+
+    /**
+      Posts task if it is not once-called for given number arguments in I, without future: result and exception are dropped.
+      Plugin of kernel runs task instead, so the call is counted until it returns (see in_flight()).
+      \param[in] nm index, name or key of task (see task_key) \param[in] args arguments for task \returns True if task was posted \see run(const T& nm, Args&&... args)
+    */
+    template<std::size_t I, typename T, typename... Args>
+    inline bool post(const T& nm, Args&&... args) {
+      if constexpr (I < L) {
+        if (parent_) { return run<I>(nm, std::forward<Args>(args)...).valid(); }
+        return resolve<I>(nm, [&](auto& t, iexecutor* e, adaptive_policy*) { return t.post_by(e, std::forward<Args>(args)...); });
+      } else { return false; }
+    }
+
+    /**
+      \returns Result of task called by the calling thread or empty std::any (task was not found, it is once-called or it is service).
+      \param[in] nm index, name or key of task (see task_key) \param[in] args arguments for task
+
+      Executors are bypassed, so it is for short tasks; exception of task is thrown to the caller.
+      Task is called in read-side section of snapshot of tasks, so it is alive when it was unsubscribed meanwhile. \see task::call(Args&&... args)
+    */
+    template<std::size_t I, typename T, typename... Args>
+    inline std::any call(const T& nm, Args&&... args) {
+      if constexpr (I < L) {
+        struct guard { tasks_state* s; ~guard() { if (s) { s->leave(); } } } g{parent_ ? state_.get() : nullptr}; // it leaves after read-side section
+        if (g.s) { g.s->enter(); }
+        auto r = registry_.read();
+        auto t = std::get<I>(r->tasks).lookup(nm);
+        return t ? t->call(std::forward<Args>(args)...) : std::any();
+      } else { return {}; }
+    }
+
+    /** \returns Amount of calls in flight, they are counted for plugin loaded by kernel only. \see plugins::unload_plugin(const std::string& nm, const std::chrono::duration<Rep, Period>& timeout) */
+    std::size_t in_flight() const noexcept { return state_->calls(); }
+
     /** \returns Amount tasks in storage for given number arguments in I. */
     template<std::size_t I>
     inline std::size_t count() const noexcept {
-      std::shared_lock<std::shared_mutex> lock(mtx_);
-      if constexpr (I < L) { return std::get<I>(tasks_).count(); }
+      if constexpr (I < L) { return std::get<I>(registry_.read()->tasks).count(); }
       else { return 0; }
     }
 
-    /** \returns True if tasks in storage has task for given number arguments in I. \param[in] nm index or name of task */
+    /** \returns True if tasks in storage has task for given number arguments in I. \param[in] nm index, name or key of task (see task_key) */
     template<std::size_t I, typename T>
     inline bool has(const T& nm) const noexcept {
-      std::shared_lock<std::shared_mutex> lock(mtx_);
-      if constexpr (I < L) { return std::get<I>(tasks_).has(nm); }
+      if constexpr (I < L) { return std::get<I>(registry_.read()->tasks).has(nm); }
       else { return false; }
     }
 
-    /** \returns True if tasks in storage has onced-flag for given number arguments in I. \param[in] nm index or name of task */
+    /** \returns True if storage has typed task with signature S. \param[in] nm index, name or key of task (see task_key) */
+    template<typename S, typename T>
+    inline bool has(const T& nm) const noexcept {
+      constexpr std::size_t I = signature_traits<S>::arity;
+      if constexpr (I < L) { return std::get<I>(registry_.read()->tasks)[nm].template is_typed<S>(); }
+      else { return false; }
+    }
+
+    /** \returns True if tasks in storage has onced-flag for given number arguments in I. \param[in] nm index, name or key of task (see task_key) */
     template<std::size_t I, typename T>
     inline bool is_once(const T& nm) const noexcept {
-      std::shared_lock<std::shared_mutex> lock(mtx_);
-      if constexpr (I < L) { return std::get<I>(tasks_)[nm].is_once(); }
+      if constexpr (I < L) { return std::get<I>(registry_.read()->tasks)[nm].is_once(); }
       else { return false; }
     }
 
-    /** \returns Name of task in storage for given number arguments in I. \param[in] nm index or name of task */
+    /** \returns Name of task in storage for given number arguments in I. \param[in] nm index, name or key of task (see task_key) */
     template<std::size_t I, typename T>
     std::string name(const T& nm) const noexcept {
-      std::shared_lock<std::shared_mutex> lock(mtx_);
-      if constexpr (I < L) { return std::get<I>(tasks_)[nm].name(); }
+      if constexpr (I < L) { return std::get<I>(registry_.read()->tasks)[nm].name(); }
       else { return {}; }
     }
 
-    /** \returns Message help for task in storage for given number arguments in I. \param[in] nm index or name of task */
+    /** \returns Message help for task in storage for given number arguments in I. \param[in] nm index, name or key of task (see task_key) */
     template<std::size_t I, typename T>
     std::string help(const T& nm) const noexcept {
-      std::shared_lock<std::shared_mutex> lock(mtx_);
-      if constexpr (I < L) { return std::get<I>(tasks_)[nm].help(); }
+      if constexpr (I < L) { return std::get<I>(registry_.read()->tasks)[nm].help(); }
       else { return {}; }
     }
 
-    /** \returns Idle(in minutes) for task in storage for given number arguments in I. \param[in] nm index or name of task */
+    /** \returns Idle(in minutes) for task in storage for given number arguments in I. \param[in] nm index, name or key of task (see task_key) */
     template<std::size_t I, typename T>
     inline int idle(const T& nm) const noexcept {
-      std::shared_lock<std::shared_mutex> lock(mtx_);
-      if constexpr (I < L) { return std::get<I>(tasks_)[nm].idle(); }
+      if constexpr (I < L) { return std::get<I>(registry_.read()->tasks)[nm].idle(); }
       else { return 0; }
     }
 
     /** \returns Idle(in minutes) for all tasks in storage for given number arguments in I. */
     template<std::size_t I>
     inline int idle() const noexcept {
-      std::shared_lock<std::shared_mutex> lock(mtx_);
-      if constexpr (I < L) { return std::get<I>(tasks_).idle(); }
+      if constexpr (I < L) { return std::get<I>(registry_.read()->tasks).idle(); }
       else { return 0; }
     }
 
@@ -206,6 +525,51 @@ namespace micro {
       clear_once_impl<I+1>(ts);
     }
 
+    // writer: changes copy of registry and publishes it (mtx_ must be locked), e - change can make resolved task unreachable
+    template<typename F>
+    void update(F&& f, bool e = true) {
+      auto r = std::make_unique<registry>(*registry_.read());
+      f(*r);
+      r = registry_.exchange(std::move(r));
+      if (e) { state_->expire(); } // after exchange and before retiring, see bind(const T& nm)
+      registry_.retire(std::move(r));
+    }
+
+    // elements of range shared by jobs of batch, rvalue std::vector is moved
+    template<typename R>
+    static auto shared_range(R&& range) {
+      using E = std::decay_t<decltype(*std::begin(range))>;
+      if constexpr (std::is_same_v<std::decay_t<R>, std::vector<E>> && std::is_rvalue_reference_v<R&&>) { return std::make_shared<const std::vector<E>>(std::move(range)); }
+      else { return std::make_shared<const std::vector<E>>(std::begin(range), std::end(range)); }
+    }
+
+    // counts call of plugin until its future is ready, f starts the call (it leaves read-side section before the call can leave)
+    template<typename F>
+    inline auto counted(F&& f) {
+      if (!parent_) { return f(); }
+      state_->enter();
+      try {
+        auto ret = f();
+        if (ret.valid()) { ret.on_ready([s = state_.get()]() { s->leave(); }); } // kernel waits for it, so pointer is enough (and it needs no allocation)
+        else { state_->leave(); }
+        return ret;
+      } catch (...) { state_->leave(); throw; }
+    }
+
+    // calls f(task, executor, adaptive policy) in read-side section, they are kept alive by snapshot of registry (or by snapshot of kernel,
+    // if registry has no executor), so nothing is shared by the call; result is empty, if task was not found
+    template<std::size_t I, typename T, typename F>
+    inline auto resolve(const T& nm, F&& f) const {
+      using task_type = typename std::tuple_element_t<I, decltype(registry::tasks)>::task_type;
+      using result_type = decltype(f(std::declval<task_type&>(), static_cast<iexecutor*>(nullptr), static_cast<adaptive_policy*>(nullptr)));
+      auto r = registry_.read();
+      task_type* t = std::get<I>(r->tasks).lookup(nm);
+      if (!t) { return result_type(); }
+      if (r->executor || !parent_) { return f(*t, r->executor.get(), r->adaptive.get()); }
+      auto p = parent_->registry_.read();
+      return f(*t, p->executor.get(), p->adaptive.get());
+    }
+
   };
 
 } // namespace micro
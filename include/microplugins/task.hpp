@@ -2,15 +2,23 @@
 #ifndef TASK_HPP_INCLUDED
 #define TASK_HPP_INCLUDED
 
-#include "time.hpp"
+#include "coalescer.hpp"
+#include "result_cache.hpp"
+#include "single_flight.hpp"
+#include "thread_pool.hpp"
 
 #include <future>
 #include <functional>
 #include <any>
 #include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <memory>
 #include <type_traits>
+#include <typeinfo>
 #include <limits> // std::numeric_limits
+#include <thread>
+#include <tuple>
 
 #ifndef MAX_PLUGINS_ARGS
 #define MAX_PLUGINS_ARGS 6
@@ -18,6 +26,140 @@
 
 namespace micro {
 
+  /**
+    \struct signature_traits
+    \brief Traits of signature of typed task
+    \copyright Boost Software License - Version 1.0
+
+    \see task::typed(const F& f)
+  */
+  template<typename S> struct signature_traits;
+
+  template<typename R, typename... Args>
+  struct signature_traits<R(Args...)> {
+    using result_type = R; ///< type of result
+    static constexpr std::size_t arity = sizeof...(Args); ///< amount of arguments
+
+    /** \returns Untyped function, which unboxes arguments (std::bad_any_cast for arguments of other types) and boxes result of typed function. \param[in] f typed function */
+    static auto boxed(std::function<R(Args...)> f) {
+      return [f = std::move(f)](auto... as) -> std::any {
+        if constexpr (std::is_void_v<R>) { f(std::any_cast<std::decay_t<Args>>(std::move(as))...); return {}; }
+        else { return f(std::any_cast<std::decay_t<Args>>(std::move(as))...); }
+      };
+    }
+  };
+
+  /**
+    \struct is_async_task
+    \brief True if function F returns future<std::any> for arguments Ts (asynchronous task, e.g. coroutine)
+    \see task::async(const std::function<future<std::any>(Ts...)>& f)
+  */
+  template<typename F, typename Enable, typename... Ts>
+  struct is_async_task_impl : std::false_type {};
+
+  template<typename F, typename... Ts>
+  struct is_async_task_impl<F, std::enable_if_t<std::is_same_v<std::invoke_result_t<const F&, Ts...>, future<std::any>>>, Ts...> : std::true_type {};
+
+  template<typename F, typename... Ts>
+  struct is_async_task : is_async_task_impl<F, void, Ts...> {};
+
+  /**
+    \struct is_tuple
+    \brief True for std::tuple and std::pair, element of batch is tuple of arguments or single argument
+    \see task::run_batch_by(iexecutor* e, std::shared_ptr<const std::vector<E>> batch)
+  */
+  template<typename T> struct is_tuple : std::false_type {};
+  template<typename... Ts> struct is_tuple<std::tuple<Ts...>> : std::true_type {};
+  template<typename T1, typename T2> struct is_tuple<std::pair<T1, T2>> : std::true_type {};
+
+  /** \returns Result of function for element of batch. \param[in] f function \param[in] x tuple of arguments or single argument */
+  template<typename F, typename E>
+  inline decltype(auto) apply_element(F& f, const E& x) {
+    if constexpr (is_tuple<E>::value) { return std::apply(f, x); }
+    else { return f(x); }
+  }
+
+  /** Arguments of element of batch as std::tuple of decayed types. */
+  template<typename E> struct batch_args { using type = std::tuple<std::decay_t<E>>; };
+  template<typename... Ts> struct batch_args<std::tuple<Ts...>> { using type = std::tuple<std::decay_t<Ts>...>; };
+  template<typename T1, typename T2> struct batch_args<std::pair<T1, T2>> { using type = std::tuple<std::decay_t<T1>, std::decay_t<T2>>; };
+
+  /** Columns for arguments of std::tuple. */
+  template<typename T> struct columns_of;
+  template<typename... As> struct columns_of<std::tuple<As...>> { using type = std::tuple<std::vector<As>...>; };
+
+  /** Fills columns (one contiguous array per argument) by elements [first, last) of batch, buffers of columns are reused. \param[out] c columns \param[in] b batch \param[in] first first element \param[in] last end of elements */
+  template<typename... As, typename E>
+  void batch_columns(std::tuple<std::vector<As>...>& c, const std::vector<E>& b, std::size_t first, std::size_t last) {
+    std::apply([&](auto&... v) { ((v.clear(), v.reserve(last - first)), ...); }, c);
+    for (std::size_t i = first; i < last; ++i) {
+      if constexpr (is_tuple<E>::value) {
+        std::apply([&](auto&... v) { std::apply([&](const auto&... x) { (v.push_back(static_cast<As>(x)), ...); }, b[i]); }, c);
+      } else { std::get<0>(c).push_back(static_cast<std::tuple_element_t<0, std::tuple<As...>>>(b[i])); }
+    }
+  }
+
+  /** Calls f(first, last) for blocks of [first, last), blocks of batch_block elements fit into cache of core. */
+  template<typename F>
+  inline void for_blocks(std::size_t first, std::size_t last, F&& f) {
+    constexpr std::size_t batch_block = 1024;
+    for (std::size_t i = first; i < last; i += batch_block) { f(i, std::min(last, i + batch_block)); }
+  }
+
+  /**
+    \class task_stats
+    \brief Moving estimate of duration of task
+    \copyright Boost Software License - Version 1.0
+
+    Each call is measured until the first estimate, then about one of sample_period calls is measured,
+    so measuring costs nearly nothing. Estimate is exponential moving average with weight 1/8 of new sample.
+
+    \see adaptive_policy
+  */
+  class task_stats final {
+  private:
+
+    std::atomic<std::int64_t> estimate_; // nanoseconds, negative - unknown
+    std::atomic<bool> inline_; // last decision of adaptive_policy
+
+  public:
+
+    static constexpr std::uint32_t sample_period = 16; ///< one of calls is measured, in average
+
+    /** Creates statistics without estimate. */
+    task_stats():estimate_(-1),inline_(false) {}
+
+    task_stats(const task_stats& rhs) = delete;
+
+    ~task_stats() {}
+
+    /** \returns Estimate of duration in nanoseconds, negative if task was not measured yet. */
+    inline std::int64_t estimate() const noexcept { return estimate_.load(std::memory_order_relaxed); }
+
+    /** \returns True if last call was executed inline. \see adaptive_policy */
+    inline bool is_inline() const noexcept { return inline_.load(std::memory_order_relaxed); }
+
+    /** Remembers decision for last call. \param[in] b true - call is executed inline */
+    inline void is_inline(bool b) noexcept { if (inline_.load(std::memory_order_relaxed) != b) { inline_.store(b, std::memory_order_relaxed); } }
+
+    /** \returns True if the next call should be measured. */
+    inline bool sample() const noexcept {
+      if (estimate() < 0) { return true; }
+      static thread_local std::uint32_t x = std::uint32_t(std::hash<std::thread::id>()(std::this_thread::get_id())) | 1;
+      x ^= x << 13; x ^= x >> 17; x ^= x << 5; // xorshift
+      return (x % sample_period) == 0;
+    }
+
+    /** Adds sample into estimate. \param[in] ns duration of call in nanoseconds */
+    inline void record(std::int64_t ns) noexcept {
+      std::int64_t e = estimate();
+      estimate_.store(e < 0 ? ns : e + (ns - e) / 8, std::memory_order_relaxed);
+    }
+
+    task_stats& operator=(const task_stats& rhs) = delete;
+
+  };
+
   /**
     \class task
     \brief Extended functor
@@ -27,14 +169,34 @@ namespace micro {
 
     Template functor with returning value type std::any and any type of arguments.
 
+    Task is executed by own executor, if it was set, otherwise by executor given by owner of task (see storage),
+    or by workers of thread_pool::get().
+
+    Typed task keeps also function with native types of arguments and result, it is called by run_as<R(Args...)>(args...)
+    without boxing into std::any; untyped callers call it by run(args...) as any other task.
+
+    Batch handler gets whole arrays of arguments (e.g. for SIMD), callers of batches prefer it to the scalar function (see batch(const F& f)).
+    Single calls of task with batch handler can be micro-batched: concurrent calls are collected into one invocation of handler (see micro_batch(const std::chrono::duration<Rep, Period>& window, std::size_t max_calls)).
+    Concurrent calls with equal arguments can share one execution (see flights(std::shared_ptr<const any_keys> keys)),
+    results of pure task can be memoized (see cache(std::shared_ptr<result_cache> c)).
+
+    Asynchronous task returns future<std::any> instead of result (e.g. it is coroutine, see coroutine.hpp),
+    worker of executor is released when function returns, while result is still pending.
+
     \code
     micro::task<int,int> t2 = [](int a, int b)->std::any{return a+b;};
-    std::shared_future<std::any> result = t2(10, 90); result.wait();
+    micro::future<std::any> result = t2(10, 90); result.wait();
     std::cout << std::any_cast<int>(result.get()) << std::endl;
 
     t2.name("sum2");
     t2.help("function for sum two integers; returns std::any");
 
+    t2.executor(std::make_shared<micro::async_executor>()); // thread per call, like std::async
+
+    micro::task<std::any,std::any> t3;
+    t3.typed<int(int,int)>([](int a, int b) { return a + b; });
+    micro::future<int> typed_result = t3.run_as<int(int,int)>(10, 90); // std::any is not involved
+
     if (!t2.empty()) t2.reset();
     \endcode
   */
@@ -46,11 +208,28 @@ namespace micro {
     std::string name_, help_;
     decltype(std::function<std::any(Ts...)>()) fn_;
     std::atomic<bool> is_once_;
+    std::shared_ptr<iexecutor> executor_;
+    iexecutor::hints hints_;
+    const std::type_info* signature_; // of typed function, nullptr - task is untyped
+    std::shared_ptr<const void> typed_; // std::function with signature_
+    std::shared_ptr<const std::function<future<std::any>(Ts...)>> async_; // asynchronous function or nullptr
+    std::shared_ptr<task_stats> stats_; // shared with jobs, they can outlive task
+    const std::type_info* batch_signature_; // of batch handler, nullptr - task has no batch handler
+    const std::type_info* batch_args_; // std::tuple of decayed arguments of batch handler
+    std::shared_ptr<const void> batch_; // std::function with arrays of arguments, array of results and amount
+    std::shared_ptr<const std::function<void(const void*, std::size_t, std::any*)>> batch_boxed_; // batch_ for untyped callers
+    std::shared_ptr<icoalescer<Ts...>> coalescer_; // micro-batching of calls or nullptr
+    std::shared_ptr<micro::single_flight<Ts...>> flights_; // calls in flight or nullptr
+    std::shared_ptr<result_cache> cache_; // memoized results or nullptr
 
   public:
 
+    static constexpr std::size_t batch_chunk = 64; ///< minimal amount of elements of batch for one chunk
+    static constexpr std::size_t batch_chunks = 4; ///< chunks of batch per thread of executor, when size of chunk is not given
+
     /** Creates empty task. */
-    task():clock_(micro::now()),name_(),help_(),fn_(nullptr),is_once_(false) {}
+    task():clock_(micro::now()),name_(),help_(),fn_(nullptr),is_once_(false),executor_(nullptr),hints_(),signature_(nullptr),typed_(),async_(),stats_(std::make_shared<task_stats>()),
+    batch_signature_(nullptr),batch_args_(nullptr),batch_(),batch_boxed_(),coalescer_(),flights_(),cache_() {}
 
     /** Creates task. \param[in] nm name of task \param[in] t function/method/lambda \param[in] hlp message help for task \see name(), help(), run(Args&&... args), run_once(Args&&... args) */
     task(const std::string& nm, const decltype(std::function<std::any(Ts...)>()) &t, const std::string& hlp = {}):task() {
@@ -76,30 +255,155 @@ namespace micro {
       return nargs;
     }
 
-    /** \returns Shared future for result task called. \param[in] args arguments for task */
+    /** \returns Future for result task called. \param[in] args arguments for task */
     template<typename... Args>
-    inline std::shared_future<std::any> run(Args&&... args) {
+    inline future<std::any> run(Args&&... args) { return run_by(nullptr, std::forward<Args>(args)...); }
+
+    /** \returns Future for result task called once. \param[in] args arguments for task */
+    template<typename... Args>
+    inline future<std::any> run_once(Args&&... args) { return run_once_by(nullptr, std::forward<Args>(args)...); }
+
+    /** \returns Future for result task called. \param[in] e executor for task without own executor, nullptr - thread_pool::get() \param[in] args arguments for task \see executor(std::shared_ptr<iexecutor> e) */
+    template<typename... Args>
+    inline future<std::any> run_by(iexecutor* e, Args&&... args) {
       if (is_once_ || !fn_) { return {}; }
       else {
         clock_ = micro::now();
-        return std::async(std::launch::async, fn_, std::forward<Args>(args)...);
+        if ((cache_ || flights_) && !is_service()) { return memoized(e, std::tuple<Ts...>(std::forward<Args>(args)...)); }
+        return dispatch(e, std::forward<Args>(args)...);
       }
     }
 
-    /** \returns Shared future for result task called once. \param[in] args arguments for task */
+    /** \returns Future for result task called once. \param[in] e executor for task without own executor, nullptr - thread_pool::get() \param[in] args arguments for task \see executor(std::shared_ptr<iexecutor> e) */
     template<typename... Args>
-    inline std::shared_future<std::any> run_once(Args&&... args) {
+    inline future<std::any> run_once_by(iexecutor* e, Args&&... args) {
       if (is_once_ || !fn_) { return {}; }
       else {
         is_once_ = true;
         clock_ = micro::now();
-        return std::async(std::launch::async, fn_, std::forward<Args>(args)...);
+        return async_ ? launch_async(e, std::forward<Args>(args)...) : launch(e, job(std::forward<Args>(args)...));
+      }
+    }
+
+    /**
+      \returns Future for result task called, by the calling thread or by executor as policy decides by measured duration of task.
+      \param[in] e executor for task without own executor, nullptr - thread_pool::get() \param[in] a policy, nullptr - as run_by(iexecutor* e, Args&&... args) \param[in] args arguments for task
+      \see adaptive_policy, stats()
+    */
+    template<typename... Args>
+    inline future<std::any> run_adaptive_by(iexecutor* e, adaptive_policy* a, Args&&... args) {
+      if (!a || executor_ || async_ || coalescer_ || flights_ || cache_ || is_service()) { return run_by(e, std::forward<Args>(args)...); }
+      if (is_once_ || !fn_) { return {}; }
+      clock_ = micro::now();
+      bool in = a->choose(stats_->estimate(), stats_->is_inline());
+      stats_->is_inline(in);
+      auto f = measured(job(std::forward<Args>(args)...), stats_->sample());
+      if (in) { inline_executor ex; return ex.submit(std::move(f), hints_); }
+      return launch(e, std::move(f));
+    }
+
+    /**
+      \returns Future for results of task called for each element of batch, in order of elements.
+      \param[in] e executor for task without own executor, nullptr - thread_pool::get() \param[in] batch tuples of arguments (or single arguments for task with one argument)
+      \param[in] grain elements in chunk, 0 - batch_chunks chunks per thread of executor (at least batch_chunk elements)
+
+      Batch is partitioned into chunks, jobs of executor (one per its thread) take next chunk while there are chunks, so uneven chunks are balanced. First exception of task fails whole batch.
+      Batch handler (see batch(const F& f)) is preferred if types of elements are its types of arguments, it gets results boxed into std::any.
+      Asynchronous task is started for each element and result is ready when all of them are ready. Empty future for service.
+    */
+    template<typename E>
+    future<std::vector<std::any>> run_batch_by(iexecutor* e, std::shared_ptr<const std::vector<E>> batch, std::size_t grain = 0) {
+      using A = typename batch_args<E>::type;
+      if (is_once_ || !fn_ || is_service() || !batch) { return {}; }
+      clock_ = micro::now();
+      const std::size_t n = std::size(*batch);
+      if (batch_boxed_ && *batch_args_ == typeid(A)) {
+        auto out = std::make_shared<std::vector<std::any>>(n);
+        return partitioned<std::vector<std::any>>(e, n, grain, [out, batch, h = batch_boxed_](std::size_t first, std::size_t last) {
+          typename columns_of<A>::type c;
+          for_blocks(first, last, [&](std::size_t f, std::size_t l) { batch_columns(c, *batch, f, l); (*h)(&c, l - f, out->data() + f); });
+        }, [out](const promise<std::vector<std::any>>& p) { p.set_value(std::move(*out)); });
+      }
+      if (async_) {
+        auto out = std::make_shared<std::vector<future<std::any>>>(n);
+        return partitioned<std::vector<std::any>>(e, n, grain, [out, batch, fn = async_](std::size_t first, std::size_t last) {
+          for (std::size_t i = first; i < last; ++i) { (*out)[i] = apply_element(*fn, (*batch)[i]); }
+        }, [out, fn = async_](const promise<std::vector<std::any>>& p) {
+          when_all(std::move(*out)).then([fn](const std::vector<future<std::any>>& fs) { // fn is kept until all coroutines are finished
+            std::vector<std::any> r;
+            r.reserve(std::size(fs));
+            for (const auto& f : fs) { r.push_back(f.get()); }
+            return r;
+          }).forward_to(p);
+        });
       }
+      auto out = std::make_shared<std::vector<std::any>>(n);
+      return partitioned<std::vector<std::any>>(e, n, grain, [out, batch, fn = std::make_shared<const std::function<std::any(Ts...)>>(fn_)](std::size_t first, std::size_t last) {
+        for (std::size_t i = first; i < last; ++i) { (*out)[i] = apply_element(*fn, (*batch)[i]); }
+      }, [out](const promise<std::vector<std::any>>& p) { p.set_value(std::move(*out)); });
+    }
+
+    /**
+      \returns Future for typed results of task called for each element of batch or empty future if task can not be called with signature S.
+      \param[in] e executor for task without own executor, nullptr - thread_pool::get() \param[in] batch tuples of arguments (or single arguments for task with one argument)
+      \param[in] grain elements in chunk, 0 - by concurrency of executor
+
+      Batch handler with signature S is preferred, then typed function with signature S, then untyped function (results are unboxed by std::any_cast).
+      \see run_batch_by(iexecutor* e, std::shared_ptr<const std::vector<E>> batch), batch(const F& f)
+    */
+    template<typename S, typename E>
+    inline future<std::vector<typename signature_traits<S>::result_type>> run_batch_as_by(iexecutor* e, std::shared_ptr<const std::vector<E>> batch, std::size_t grain = 0) {
+      return typed_batch_run(static_cast<S*>(nullptr), e, std::move(batch), grain);
+    }
+
+    /** \returns True if task was posted, result and exception of task are dropped. \param[in] e executor for task without own executor, nullptr - thread_pool::get() \param[in] args arguments for task \see run_by(iexecutor* e, Args&&... args) */
+    template<typename... Args>
+    inline bool post_by(iexecutor* e, Args&&... args) {
+      if (is_once_ || !fn_) { return false; }
+      clock_ = micro::now();
+      if (coalescer_) { coalescer_->run(std::forward<Args>(args)...); return true; }
+      with_executor(e, [&](iexecutor& ex) {
+        if (async_) { ex.post(dropped([fn = async_, a = std::tuple<std::decay_t<Args>...>(std::forward<Args>(args)...)]() mutable { return started(fn, std::move(a)); }), hints_); }
+        else { ex.post(dropped(job(std::forward<Args>(args)...)), hints_); }
+      });
+      return true;
+    }
+
+    /** \returns Result of task called by the calling thread or empty std::any if task is empty, once-called or service (service must not occupy the caller, use run). Exception of task is thrown to the caller. \param[in] args arguments for task */
+    template<typename... Args>
+    inline std::any call(Args&&... args) {
+      if (is_once_ || !fn_ || is_service()) { return {}; }
+      clock_ = micro::now();
+      if (cache_) {
+        std::tuple<Ts...> a(std::forward<Args>(args)...);
+        any_key k;
+        if (!cache_->keys()->make(a, k)) { return std::apply(fn_, std::move(a)); }
+        std::any v;
+        if (!cache_->get(k, v)) { v = std::apply(fn_, std::move(a)); cache_->put(k, v); }
+        return v;
+      }
+      return fn_(std::forward<Args>(args)...);
+    }
+
+    /** \returns Future for result of typed task called or empty future if task has other signature. \param[in] args arguments for task \see typed(const F& f) */
+    template<typename S, typename... Args>
+    inline future<typename signature_traits<S>::result_type> run_as(Args&&... args) { return run_as_by<S>(nullptr, std::forward<Args>(args)...); }
+
+    /** \returns Future for result of typed task called or empty future if task has other signature. \param[in] e executor for task without own executor, nullptr - thread_pool::get() \param[in] args arguments for task \see run_as(Args&&... args) */
+    template<typename S, typename... Args>
+    inline future<typename signature_traits<S>::result_type> run_as_by(iexecutor* e, Args&&... args) {
+      return typed_run(static_cast<S*>(nullptr), e, false, std::forward<Args>(args)...);
+    }
+
+    /** \returns Future for result of typed task called once or empty future if task has other signature. \param[in] e executor for task without own executor, nullptr - thread_pool::get() \param[in] args arguments for task \see run_as(Args&&... args) */
+    template<typename S, typename... Args>
+    inline future<typename signature_traits<S>::result_type> run_once_as_by(iexecutor* e, Args&&... args) {
+      return typed_run(static_cast<S*>(nullptr), e, true, std::forward<Args>(args)...);
     }
 
     /** \see run(Args&&... args) */
     template<typename... Args>
-    inline std::shared_future<std::any> operator()(Args&&... args) { return run(std::forward<Args>(args)...); }
+    inline future<std::any> operator()(Args&&... args) { return run(std::forward<Args>(args)...); }
 
     /** \returns True if name of task 'service' and numbers of args is 1. */
     inline bool is_service() const noexcept { return (max_args() == 1 && name_ == "service"); }
@@ -122,18 +426,112 @@ namespace micro {
     /** Sets message help for task. \param[in] hlp message help \see help() */
     void help(const std::string& hlp) noexcept { help_ = hlp; }
 
+    /** \returns Own executor of task or nullptr. \see executor(std::shared_ptr<iexecutor> e) */
+    const std::shared_ptr<iexecutor>& executor() const noexcept { return executor_; }
+
+    /** Sets own executor for task, it must not be called while task is running (storage does it under own lock). \param[in] e executor, nullptr - executor of owner \param[in] h hints for scheduling \see executor() */
+    void executor(std::shared_ptr<iexecutor> e, const iexecutor::hints& h = {}) noexcept {
+      hints_ = h;
+      executor_ = std::move(e);
+    }
+
+    /** Sets typed function, untyped function of task is replaced by its wrapper. \param[in] f function/method/lambda with signature S (native types of arguments and result) \see run_as(Args&&... args), is_typed() */
+    template<typename S, typename F>
+    void typed(const F& f) { typed_impl(std::function<S>(f)); }
+
+    /** Sets asynchronous function, untyped function of task is replaced by wrapper, which waits for result. \param[in] f function/method/lambda/coroutine returning future \see is_async() */
+    void async(const std::function<future<std::any>(Ts...)>& f) {
+      if (!f) { return; }
+      fn_ = [f](Ts... as) -> std::any { return f(std::move(as)...).get(); };
+      signature_ = nullptr;
+      typed_ = nullptr;
+      async_ = std::make_shared<const std::function<future<std::any>(Ts...)>>(f);
+    }
+
+    /** \returns True if task is asynchronous. \see async(const std::function<future<std::any>(Ts...)>& f) */
+    inline bool is_async() const noexcept { return !!async_; }
+
+    /**
+      Sets batch handler with signature S = R(Args...), it gets contiguous arrays of arguments and fills array of results:
+      void(const Args*... args, R* results, std::size_t n), R must be default constructible. Task without function gets typed function, which calls handler for one element.
+      \param[in] f function/method/lambda \see run_batch_as_by(iexecutor* e, std::shared_ptr<const std::vector<E>> batch), has_batch()
+
+      \code
+      t.batch<double(double,double)>([](const double* a, const double* b, double* r, std::size_t n) { for (std::size_t i = 0; i < n; ++i) r[i] = a[i] + b[i]; });
+      \endcode
+    */
+    template<typename S, typename F>
+    void batch(const F& f) { batch_impl(static_cast<S*>(nullptr), f); }
+
+    /** \returns True if task has batch handler with signature S. \see batch(const F& f) */
+    template<typename S>
+    inline bool has_batch() const noexcept { return (batch_signature_ && batch_ && *batch_signature_ == typeid(S)); }
+
+    /**
+      Sets micro-batching: calls of task (run, post, run_as with signature S) are collected for window or up to max_calls
+      and given to batch handler in one invocation, each caller gets own result. Once-calls are not collected.
+      It must not be called while task is running (storage does it under own lock).
+      \returns True if micro-batching was set or removed, false if task has no batch handler with signature S.
+      \param[in] window maximal time of collecting of batch, zero - removes micro-batching \param[in] max_calls maximal amount of calls in batch
+      \see batch(const F& f), coalescer
+    */
+    template<typename S, typename Rep, typename Period>
+    bool micro_batch(const std::chrono::duration<Rep, Period>& window, std::size_t max_calls) {
+      if (window <= window.zero()) { coalescer_ = nullptr; return true; }
+      if (!has_batch<S>()) { return false; }
+      using C = coalescer<S, Ts...>;
+      coalescer_ = std::make_shared<C>(std::static_pointer_cast<const typename C::handler_type>(batch_), window, max_calls);
+      return true;
+    }
+
+    /**
+      Sets single-flight mode: calls by run with equal arguments (compared by keys) share one execution while it is in flight.
+      It must not be called while task is running (storage does it under own lock).
+      \param[in] keys registry of types of arguments, nullptr - removes single-flight mode \see flights(), single_flight
+    */
+    void flights(std::shared_ptr<const any_keys> keys) { flights_ = keys ? std::make_shared<micro::single_flight<Ts...>>(std::move(keys)) : nullptr; }
+
+    /** \returns Calls in flight or nullptr if task has no single-flight mode. \see flights(std::shared_ptr<const any_keys> keys) */
+    const std::shared_ptr<micro::single_flight<Ts...>>& flights() const noexcept { return flights_; }
+
+    /**
+      Sets cache of results: calls by run and call with arguments of cached result get it without execution.
+      It must not be called while task is running (storage does it under own lock).
+      \param[in] c cache, nullptr - removes cache \see cache(), result_cache
+    */
+    void cache(std::shared_ptr<result_cache> c) noexcept { cache_ = std::move(c); }
+
+    /** \returns Cache of results or nullptr. \see cache(std::shared_ptr<result_cache> c) */
+    const std::shared_ptr<result_cache>& cache() const noexcept { return cache_; }
+
+    /** \returns True if calls of task are micro-batched. \see micro_batch(const std::chrono::duration<Rep, Period>& window, std::size_t max_calls) */
+    inline bool is_micro_batched() const noexcept { return !!coalescer_; }
+
+    /** \returns True if task has typed function with signature S. \see typed(const F& f) */
+    template<typename S>
+    inline bool is_typed() const noexcept { return (signature_ && typed_ && *signature_ == typeid(S)); }
+
+    /** \returns Measured duration of task. \see run_adaptive_by(iexecutor* e, adaptive_policy* a, Args&&... args) */
+    const task_stats& stats() const noexcept { return *stats_; }
+
+    /** \returns Hints for scheduling of task. \see executor(std::shared_ptr<iexecutor> e, const iexecutor::hints& h) */
+    const iexecutor::hints& hints() const noexcept { return hints_; }
+
     /** \returns Idle for task in minutes */
     inline int idle()  const noexcept { return int(micro::duration<micro::minutes>(clock_, micro::now())); }
 
     /** Resets pointer to function. */
-    void reset() noexcept { fn_ = nullptr; }
+    void reset() noexcept { fn_ = nullptr; typed_ = nullptr; async_ = nullptr; batch_ = nullptr; batch_boxed_ = nullptr; batch_signature_ = nullptr; batch_args_ = nullptr; coalescer_ = nullptr; flights_ = nullptr; cache_ = nullptr; }
 
     /** \returns True if task is nulled. */
-    bool empty() const noexcept { return (fn_.target() == nullptr); }
+    bool empty() const noexcept { return !fn_; }
 
     /** Assignment. \param[in] t function/method/lambda */
     task<Ts...>& operator=(const decltype(std::function<std::any(Ts...)>()) &t) {
       fn_ = t;
+      signature_ = nullptr;
+      typed_ = nullptr;
+      async_ = nullptr;
       return *this;
     }
 
@@ -144,7 +542,20 @@ namespace micro {
         name_ = rhs.name_;
         help_ = rhs.help_;
         fn_ = rhs.fn_;
-        is_once_ = rhs.is_once_;
+        is_once_ = rhs.is_once_.load();
+        executor_ = rhs.executor_;
+        hints_ = rhs.hints_;
+        signature_ = rhs.signature_;
+        typed_ = rhs.typed_;
+        async_ = rhs.async_;
+        stats_ = rhs.stats_;
+        batch_signature_ = rhs.batch_signature_;
+        batch_args_ = rhs.batch_args_;
+        batch_ = rhs.batch_;
+        batch_boxed_ = rhs.batch_boxed_;
+        coalescer_ = rhs.coalescer_;
+        flights_ = rhs.flights_;
+        cache_ = rhs.cache_;
       } return *this;
     }
 
@@ -155,10 +566,230 @@ namespace micro {
         name_ = std::move(rhs.name_);
         help_ = std::move(rhs.help_);
         fn_ = std::move(rhs.fn_);
-        is_once_ = rhs.is_once_; // std::atomic is not movable
+        is_once_ = rhs.is_once_.load(); // std::atomic is not movable
+        executor_ = std::move(rhs.executor_);
+        hints_ = rhs.hints_;
+        signature_ = rhs.signature_;
+        typed_ = std::move(rhs.typed_);
+        async_ = std::move(rhs.async_);
+        stats_ = rhs.stats_; // moved task stays usable
+        batch_signature_ = rhs.batch_signature_;
+        batch_args_ = rhs.batch_args_;
+        batch_ = std::move(rhs.batch_);
+        batch_boxed_ = std::move(rhs.batch_boxed_);
+        coalescer_ = std::move(rhs.coalescer_);
+        flights_ = std::move(rhs.flights_);
+        cache_ = std::move(rhs.cache_);
       } return *this;
     }
 
+  private:
+
+    // starts call by micro-batching, asynchronous function or job of executor
+    template<typename... Args>
+    inline future<std::any> dispatch(iexecutor* e, Args&&... args) {
+      if (coalescer_) { return coalescer_->run(std::forward<Args>(args)...); }
+      return async_ ? launch_async(e, std::forward<Args>(args)...) : launch(e, job(std::forward<Args>(args)...));
+    }
+
+    // call by cache of results and by calls in flight
+    future<std::any> memoized(iexecutor* e, std::tuple<Ts...> a) {
+      any_key k;
+      const bool keyed = cache_ && cache_->keys()->make(a, k);
+      if (std::any v; keyed && cache_->get(k, v)) {
+        promise<std::any> p;
+        p.set_value(std::move(v));
+        return p.get_future();
+      }
+      auto start = [this, e](std::tuple<Ts...>&& xs) { return std::apply([this, e](Ts&&... ys) { return dispatch(e, std::move(ys)...); }, std::move(xs)); };
+      future<std::any> r = flights_ ? flights_->run(std::move(a), start) : start(std::move(a));
+      if (!keyed || !r.valid()) { return r; }
+      // result is cached before the caller gets it, so next call with equal arguments is a hit
+      promise<std::any> p;
+      future<std::any> ret = p.get_future();
+      r.on_ready([c = cache_, k = std::move(k), r, p]() {
+        try { c->put(k, r.get()); } catch (...) {} // exception is not cached
+        r.forward_to(p);
+      });
+      return ret;
+    }
+
+    // copy of function is released by the call, so code of unloaded plugin is not called after result is set (see storage::in_flight())
+    template<typename... Args>
+    inline auto job(Args&&... args) const {
+      return [fn = fn_, a = std::tuple<std::decay_t<Args>...>(std::forward<Args>(args)...)]() mutable { auto f = std::move(fn); return std::apply(f, std::move(a)); };
+    }
+
+    // partitions [0, n) into chunks of grain elements (0 - by concurrency of executor), jobs of executor (not more than its concurrency) claim chunks
+    // until all of them are taken, so faster jobs take more chunks; f(first, last) is called for each chunk and done(p) by the last job,
+    // each job releases f before it finishes, so result (or first exception) is set after no job holds f
+    template<typename R, typename F, typename D>
+    future<R> partitioned(iexecutor* e, std::size_t n, std::size_t grain, F&& f, D&& done) {
+      struct state {
+        std::atomic<std::size_t> next;
+        std::atomic<std::size_t> left;
+        std::atomic<bool> failed;
+        std::exception_ptr error;
+        promise<R> p;
+      };
+      auto st = std::make_shared<state>();
+      future<R> ret = st->p.get_future();
+      st->next = 0;
+      st->failed = false;
+      if (!n) { done(st->p); return ret; }
+      with_executor(e, [&](iexecutor& ex) {
+        const std::size_t c = std::max<std::size_t>(1, ex.concurrency());
+        const std::size_t chunk = grain ? grain : std::max(batch_chunk, (n + batch_chunks * c - 1) / (batch_chunks * c));
+        const std::size_t jobs = std::min(c, (n + chunk - 1) / chunk);
+        st->left = jobs;
+        auto fc = std::make_shared<std::decay_t<F>>(std::forward<F>(f));
+        auto dc = std::make_shared<std::decay_t<D>>(std::forward<D>(done));
+        for (std::size_t i = 0; i < jobs; ++i) {
+          ex.post([st, fc, dc, n, chunk]() mutable {
+            try {
+              for (std::size_t first = st->next.fetch_add(chunk); first < n && !st->failed; first = st->next.fetch_add(chunk)) { (*fc)(first, std::min(n, first + chunk)); }
+            } catch (...) { if (!st->failed.exchange(true)) { st->error = std::current_exception(); } }
+            fc = nullptr;
+            if (--st->left) { return; }
+            if (st->failed) { st->p.set_exception(st->error); return; }
+            try { (*dc)(st->p); }
+            catch (...) { st->p.set_exception(std::current_exception()); }
+          }, hints_);
+        }
+      });
+      return ret;
+    }
+
+    template<typename R, typename... Ps, typename E>
+    future<std::vector<R>> typed_batch_run(R(*)(Ps...), iexecutor* e, std::shared_ptr<const std::vector<E>> batch, std::size_t grain) {
+      using A = typename batch_args<E>::type;
+      static_assert(!std::is_void_v<R> && !std::is_same_v<R, bool>, "\n\nResult of batch must not be void or bool (std::vector<bool> has no contiguous storage).\n");
+      static_assert(std::is_default_constructible_v<R>, "\n\nResult of batch must be default constructible (handler fills array of results).\n");
+      if (is_once_ || !fn_ || is_service() || !batch) { return {}; }
+      clock_ = micro::now();
+      const std::size_t n = std::size(*batch);
+      auto out = std::make_shared<std::vector<R>>(n);
+      auto done = [out](const promise<std::vector<R>>& p) { p.set_value(std::move(*out)); };
+      if (batch_signature_ && *batch_signature_ == typeid(R(Ps...))) {
+        return partitioned<std::vector<R>>(e, n, grain, [out, batch, h = std::static_pointer_cast<const std::function<void(const std::decay_t<Ps>*..., R*, std::size_t)>>(batch_)](std::size_t first, std::size_t last) {
+          std::tuple<std::vector<std::decay_t<Ps>>...> c;
+          for_blocks(first, last, [&](std::size_t f, std::size_t l) {
+            batch_columns(c, *batch, f, l);
+            std::apply([&](const auto&... v) { (*h)(v.data()..., out->data() + f, l - f); }, c);
+          });
+        }, std::move(done));
+      }
+      if (is_typed<R(Ps...)>()) {
+        return partitioned<std::vector<R>>(e, n, grain, [out, batch, fn = std::static_pointer_cast<const std::function<R(Ps...)>>(typed_)](std::size_t first, std::size_t last) {
+          for (std::size_t i = first; i < last; ++i) { (*out)[i] = apply_element(*fn, (*batch)[i]); }
+        }, std::move(done));
+      }
+      static_assert(std::tuple_size_v<A> == sizeof...(Ts), "\n\nAmount of arguments in elements of batch differs from amount of arguments of task.\n");
+      return partitioned<std::vector<R>>(e, n, grain, [out, batch, fn = std::make_shared<const std::function<std::any(Ts...)>>(fn_)](std::size_t first, std::size_t last) {
+        for (std::size_t i = first; i < last; ++i) { (*out)[i] = std::any_cast<R>(apply_element(*fn, (*batch)[i])); }
+      }, std::move(done));
+    }
+
+    template<typename R, typename... Args, typename F>
+    void batch_impl(R(*)(Args...), const F& f) {
+      static_assert(sizeof...(Args) == sizeof...(Ts), "\n\nAmount of arguments of batch handler differs from amount of arguments of task.\n");
+      static_assert(!std::is_void_v<R> && !std::is_same_v<R, bool>, "\n\nResult of batch must not be void or bool (std::vector<bool> has no contiguous storage).\n");
+      static_assert(std::is_default_constructible_v<R>, "\n\nResult of batch must be default constructible (handler fills array of results).\n");
+      using H = std::function<void(const std::decay_t<Args>*..., R*, std::size_t)>;
+      auto h = std::make_shared<const H>(f);
+      if (!*h) { return; }
+      batch_signature_ = &typeid(R(Args...));
+      batch_args_ = &typeid(std::tuple<std::decay_t<Args>...>);
+      batch_ = h;
+      coalescer_ = nullptr; // it holds previous handler
+      batch_boxed_ = std::make_shared<const std::function<void(const void*, std::size_t, std::any*)>>([h](const void* c, std::size_t n, std::any* out) {
+        std::vector<R> r(n);
+        std::apply([&](const auto&... v) { (*h)(v.data()..., r.data(), n); }, *static_cast<const std::tuple<std::vector<std::decay_t<Args>>...>*>(c));
+        for (std::size_t i = 0; i < n; ++i) { out[i] = std::move(r[i]); }
+      });
+      // task without scalar function calls batch handler for one element
+      if (!fn_) { typed_impl(std::function<R(Args...)>([h](Args... as) { R r{}; (*h)(&as..., &r, 1); return r; })); }
+    }
+
+    // job which measures its duration for stats_, if sample is true
+    template<typename F>
+    inline auto measured(F&& f, bool sample) const {
+      return [f = std::forward<F>(f), s = sample ? stats_ : nullptr]() mutable {
+        if (!s) { return f(); }
+        auto started = std::chrono::steady_clock::now();
+        auto ret = f();
+        s->record(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - started).count());
+        return ret;
+      };
+    }
+
+    // job without shared state, it drops result and exception (asynchronous function is only started)
+    template<typename F>
+    static inline auto dropped(F&& f) {
+      return [f = std::forward<F>(f)]() mutable { try { f(); } catch (...) {} };
+    }
+
+    template<typename R, typename... Args>
+    void typed_impl(std::function<R(Args...)> f) {
+      static_assert(sizeof...(Args) == sizeof...(Ts), "\n\nAmount of arguments of typed function differs from amount of arguments of task.\n");
+      if (!f) { return; }
+      fn_ = signature_traits<R(Args...)>::boxed(f);
+      async_ = nullptr;
+      signature_ = &typeid(R(Args...));
+      typed_ = std::make_shared<const std::function<R(Args...)>>(std::move(f));
+    }
+
+    template<typename R, typename... Ps, typename... Args>
+    future<R> typed_run(R(*)(Ps...), iexecutor* e, bool once, Args&&... args) {
+      if (is_once_) { return {}; }
+      if (!once && coalescer_ && coalescer_->signature() == typeid(R(Ps...))) {
+        clock_ = micro::now();
+        return static_cast<coalescer<R(Ps...), Ts...>*>(coalescer_.get())->run_as(std::forward<Args>(args)...);
+      }
+      if (!is_typed<R(Ps...)>()) { return {}; }
+      if (once) { is_once_ = true; }
+      clock_ = micro::now();
+      return launch(e, [fn = std::static_pointer_cast<const std::function<R(Ps...)>>(typed_), a = std::tuple<std::decay_t<Ps>...>(std::forward<Args>(args)...)]() mutable -> R {
+        return std::apply(*fn, std::move(a));
+      });
+    }
+
+    // calls f with executor for this task
+    template<typename F>
+    inline auto with_executor(iexecutor* e, F&& f) {
+      // service is long-running loop, it must not occupy worker of any executor
+      if (is_service()) { async_executor ex; return f(static_cast<iexecutor&>(ex)); }
+      std::shared_ptr<thread_pool> pool = (executor_ || e) ? nullptr : thread_pool::get();
+      return f(executor_ ? *executor_ : e ? *e : *pool);
+    }
+
+    template<typename F>
+    inline auto launch(iexecutor* e, F&& f) {
+      return with_executor(e, [this, &f](iexecutor& ex) { return ex.submit(std::forward<F>(f), hints_); });
+    }
+
+    // result of asynchronous function, function is kept until result is set (coroutine lambda reads own captures through it, task can be unsubscribed meanwhile)
+    template<typename A>
+    static future<std::any> started(const std::shared_ptr<const std::function<future<std::any>(Ts...)>>& fn, A&& a) {
+      future<std::any> ret = std::apply(*fn, std::forward<A>(a));
+      ret.on_ready([fn]() {});
+      return ret;
+    }
+
+    // worker only starts asynchronous function, result is forwarded when it is ready
+    template<typename... Args>
+    future<std::any> launch_async(iexecutor* e, Args&&... args) {
+      promise<std::any> p;
+      future<std::any> ret = p.get_future();
+      with_executor(e, [&](iexecutor& ex) {
+        ex.post([p, fn = async_, a = std::tuple<std::decay_t<Args>...>(std::forward<Args>(args)...)]() mutable {
+          try { started(fn, std::move(a)).forward_to(p); }
+          catch (...) { p.set_exception(std::current_exception()); }
+        }, hints_);
+      });
+      return ret;
+    }
+
   };
 
 } // namespace micro
@@ -0,0 +1,194 @@
+/** \file task_handle.hpp */
+#ifndef TASK_HANDLE_HPP_INCLUDED
+#define TASK_HANDLE_HPP_INCLUDED
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+
+#include "rcu.hpp"
+#include "task.hpp"
+
+namespace micro {
+
+  /**
+    \class tasks_state
+    \brief Generation, readers of snapshots and calls in flight of storage, they are shared by storage with its resolved tasks
+    \copyright Boost Software License - Version 1.0
+
+    Generation is increased when resolved task of storage can become unreachable (unsubscribing, changing of task or executor, unloading of plugin).
+    Kernel increases generation of plugin before it waits for calls in flight, call enters before it checks generation,
+    so either the call sees new generation or kernel waits for it (both sides are sequentially consistent).
+    Calls are counted by threads (as decisions of adaptive_policy), so concurrent callers do not share a counter.
+    Domain of readers of snapshots of storage is here, so resolved task can enter read-side section after its storage was destroyed.
+
+    \see task_handle, storage::in_flight()
+  */
+  class tasks_state final {
+  private:
+
+    static constexpr std::size_t slots_count = 16;
+
+    // calls are counted by threads into separate cachelines: entered by the caller, left by the thread which finishes the call
+    struct alignas(64) slot { std::atomic<std::size_t> entered{0}, left{0}; };
+
+    slot slots_[slots_count];
+    rcu_domain domain_; // readers of snapshots of storage
+    std::atomic<bool> draining_{false}; // somebody waits for calls
+    std::mutex mtx_; // for waiter of calls
+    std::condition_variable cv_;
+
+    static std::size_t index() noexcept {
+      static std::atomic<std::size_t> next(0);
+      static thread_local std::size_t i = next++ % slots_count;
+      return i;
+    }
+
+  public:
+
+    std::atomic<std::size_t> generation{0}; ///< generation of resolved tasks
+
+    /** \returns Domain of readers of snapshots of storage. */
+    inline rcu_domain& domain() noexcept { return domain_; }
+
+    /** \returns Current generation. */
+    inline std::size_t current() const noexcept { return generation.load(); }
+
+    /** Invalidates resolved tasks. */
+    inline void expire() noexcept { generation.fetch_add(1); }
+
+    /** Enters call. */
+    inline void enter() noexcept { slots_[index()].entered.fetch_add(1); }
+
+    /** Leaves call, it does not touch state after it has left, unless somebody waits (then waiter is woken under lock). */
+    inline void leave() noexcept {
+      if (!draining_.load()) { slots_[index()].left.fetch_add(1); return; }
+      std::unique_lock<std::mutex> lock(mtx_);
+      slots_[index()].left.fetch_add(1);
+      cv_.notify_all();
+    }
+
+    /**
+      \returns Calls in flight. Left calls are summed before entered ones, so each seen left call is seen entered too
+      and zero means that no call is in flight (calls are started only by callers or by calls in flight).
+    */
+    std::size_t calls() const noexcept {
+      std::size_t l = 0, e = 0;
+      for (const slot& s : slots_) { l += s.left.load(); }
+      for (const slot& s : slots_) { e += s.entered.load(); }
+      return e - l;
+    }
+
+    /** Waits for calls in flight. */
+    void wait() noexcept {
+      std::unique_lock<std::mutex> lock(mtx_);
+      draining_ = true;
+      // call, which has left before it saw draining_, does not wake waiter, so sum is checked again
+      while (calls()) { cv_.wait_for(lock, std::chrono::milliseconds(1)); }
+    }
+  };
+
+  /**
+    \class task_handle
+    \brief Resolved task
+    \copyright Boost Software License - Version 1.0
+
+    Handle keeps pointers to task, its executor and adaptive policy, which were resolved once by storage::bind(const T& nm).
+    Calling by handle bypasses lock of storage and search of task by name, nothing is shared by the call.
+
+    Handle does not own task and it does not prevent unloading of plugin, but call by handle is counted as call of plugin
+    (see storage::in_flight()), so plugin is not unloaded while it is called.
+    Handle becomes invalid when generation of its storage was changed (see tasks_state), then it returns empty future and it should be bound again.
+    Task is called inside read-side section of snapshots of its storage (and of kernel), so snapshot with current generation keeps task alive.
+
+    \code
+    auto sum2 = plugin->bind<2>("sum2");
+    for (int i = 0; i < 1000000; ++i) {
+      if (!sum2) { sum2 = plugin->bind<2>("sum2"); }
+      micro::future<std::any> result = sum2(i, i);
+    }
+    \endcode
+  */
+  template<typename... Ts>
+  class task_handle final {
+  private:
+
+    task<Ts...>* task_;
+    iexecutor* executor_;
+    adaptive_policy* adaptive_;
+    std::shared_ptr<tasks_state> state_; // storage of task
+    std::shared_ptr<tasks_state> parent_state_; // storage of executor, if it differs
+    std::size_t generation_, parent_generation_;
+    bool counted_; // call is counted until its result is ready (plugin of kernel)
+
+  public:
+
+    /** Creates empty (invalid) handle. */
+    task_handle():task_(nullptr),executor_(nullptr),adaptive_(nullptr),state_(),parent_state_(),generation_(0),parent_generation_(0),counted_(false) {}
+
+    /**
+      Creates handle. \param[in] t resolved task \param[in] e executor for task without own executor \param[in] a adaptive policy or nullptr, they are from snapshots of storages
+      \param[in] s state of storage of task \param[in] g its generation before resolving \param[in] ps state of storage of executor or nullptr \param[in] pg its generation before resolving
+      \param[in] c call is counted until its result is ready
+    */
+    task_handle(task<Ts...>* t, iexecutor* e, adaptive_policy* a, std::shared_ptr<tasks_state> s, std::size_t g, std::shared_ptr<tasks_state> ps, std::size_t pg, bool c):
+    task_(t),executor_(e),adaptive_(a),state_(std::move(s)),parent_state_(std::move(ps)),generation_(g),parent_generation_(pg),counted_(c) {}
+
+    ~task_handle() {}
+
+    /** \returns True if task is reachable by this handle. */
+    inline bool valid() const noexcept { return (state_ && is_current()); }
+
+    /** \see valid() */
+    inline explicit operator bool() const noexcept { return valid(); }
+
+    /** \returns Future for result task called or empty future if handle is invalid. \param[in] args arguments for task \see task::run_adaptive_by() */
+    template<typename... Args>
+    inline future<std::any> run(Args&&... args) {
+      return call([&](task<Ts...>& t) { return t.run_adaptive_by(executor_, adaptive_, std::forward<Args>(args)...); });
+    }
+
+    /** \returns Future for result task called once or empty future if handle is invalid. \param[in] args arguments for task \see task::run_once(Args&&... args) */
+    template<typename... Args>
+    inline future<std::any> run_once(Args&&... args) {
+      return call([&](task<Ts...>& t) { return t.run_once_by(executor_, std::forward<Args>(args)...); });
+    }
+
+    /** \see run(Args&&... args) */
+    template<typename... Args>
+    inline future<std::any> operator()(Args&&... args) { return run(std::forward<Args>(args)...); }
+
+    /** Invalidates handle. */
+    void reset() noexcept { task_ = nullptr; executor_ = nullptr; adaptive_ = nullptr; state_ = nullptr; parent_state_ = nullptr; }
+
+  private:
+
+    inline bool is_current() const noexcept { return (generation_ == state_->current() && (!parent_state_ || parent_generation_ == parent_state_->current())); }
+
+    // call of plugin enters before generation is checked (see tasks_state)
+    template<typename F>
+    inline future<std::any> call(F&& f) {
+      if (!state_) { return {}; }
+      if (!counted_) { return call_current(f); }
+      tasks_state* s = state_.get();
+      s->enter();
+      future<std::any> ret;
+      try { ret = call_current(f); } catch (...) { s->leave(); throw; }
+      if (ret.valid()) { ret.on_ready([s]() { s->leave(); }); } // kernel waits for it, so pointer is enough (and it needs no allocation)
+      else { s->leave(); }
+      return ret;
+    }
+
+    // generation is checked inside read-side sections: snapshots of current generation are not released until sections are left
+    template<typename F>
+    inline future<std::any> call_current(F& f) {
+      rcu_domain::reader r(state_->domain()), pr = parent_state_ ? rcu_domain::reader(parent_state_->domain()) : rcu_domain::reader();
+      return is_current() ? f(*task_) : future<std::any>();
+    }
+
+  };
+
+} // namespace micro
+
+#endif // TASK_HANDLE_HPP_INCLUDED
@@ -2,12 +2,53 @@
 #ifndef TASKS_HPP_INCLUDED
 #define TASKS_HPP_INCLUDED
 
-#include "task.hpp"
+#include "task_handle.hpp"
 
-#include <map>
+#include <algorithm>
+#include <cstdint>
+#include <string_view>
+#include <vector>
 
 namespace micro {
 
+  /** \returns Hash of name of task (FNV-1a). \param[in] nm name of task */
+  inline constexpr std::uint64_t task_hash(std::string_view nm) noexcept {
+    std::uint64_t h = 14695981039346656037ull;
+    for (char c : nm) { h = (h ^ std::uint8_t(c)) * 1099511628211ull; }
+    return h;
+  }
+
+  /**
+    \struct task_key
+    \brief Name of task with its hash
+    \copyright Boost Software License - Version 1.0
+
+    Key is created by constexpr constructor or by literal _task, so hash of name is computed at compile time
+    and lookup of task does not hash name again. It is accepted everywhere instead of name of task.
+
+    \code
+    using namespace micro::literals;
+
+    constexpr micro::task_key sum2 = "sum2"_task;
+    micro::future<std::any> result = plugin->run<2>(sum2, 10, 15);
+    if (plugin->has<0>("test0"_task)) { plugin->run<0>("test0"_task); }
+    \endcode
+  */
+  struct task_key {
+    std::string_view name; ///< name of task, it must outlive key (usually it is string literal)
+    std::uint64_t hash; ///< task_hash(name)
+
+    /** Creates key. \param[in] nm name of task */
+    constexpr explicit task_key(std::string_view nm) noexcept:name(nm),hash(task_hash(nm)) {}
+  };
+
+  namespace literals {
+
+    /** \returns Key of task. \param[in] s name of task \param[in] n length of name \see task_key */
+    inline constexpr task_key operator""_task(const char* s, std::size_t n) noexcept { return task_key(std::string_view(s, n)); }
+
+  } // namespace literals
+
   /**
     \class tasks
     \brief Container for extended functors
@@ -17,65 +58,208 @@ namespace micro {
 
     Template vector for functors.
 
+    Tasks are kept in vector sorted by name (so access by index is O(1)) and they are found by name
+    through open-addressing hash table, names are compared only when hashes are equal.
+    After the last subscribing, table can be frozen by freeze(): it is rebuilt as perfect hash,
+    then each lookup probes exactly one slot. Subscribing/unsubscribing rebuilds table as ordinary one.
+    Setters of existing task replace it by its copy, so other copies of container keep previous task.
+
     \code
     micro::tasks<int,int> ts;
     micro::tasks<std::string,std::string> ts2;
 
     ts.subscribe("sum2", [](int a, int b)->std::any{return a+b;});
+    ts.subscribe<int(int,int)>("mul2", [](int a, int b) { return a*b; }); // typed task, see task::run_as(Args&&... args)
     ts2.subscribe("concatenate2", [](std::string a, std::string b)->std::any{return a+b;});
 
-    std::shared_future<std::any> result = ts["sum2"](15, 15); result.wait();
+    micro::future<std::any> result = ts["sum2"](15, 15); result.wait();
     std::cout << std::any_cast<int>(result.get()) << std::endl;
 
     std::string s1 = "hello", s2 = " world !";
     result = ts2["concatenate2"](s1, s2); result.wait();
     std::cout << std::any_cast<std::string>(result.get()) << std::endl;
+
+    ts.freeze(); // no more subscribing expected
     \endcode
   */
   template <typename... Ts>
   class tasks final {
+  public:
+
+    using task_type = task<Ts...>; ///< Type of task of container
+    using handle_type = task_handle<Ts...>; ///< Type of resolved task of container
+
+    template<typename F>
+    static constexpr bool is_async = is_async_task<F, Ts...>::value; ///< True if F is asynchronous task for this container
+
   private:
 
-    std::map<std::string, std::shared_ptr<task<Ts...>>> subscribers_;
-    task<Ts...> empty_task_; // for out of range access by operator[]
+    static constexpr std::size_t npos = std::numeric_limits<std::size_t>::max();
+
+    struct slot { std::uint64_t hash; std::size_t index; };
+
+    std::vector<std::shared_ptr<task<Ts...>>> subscribers_; // sorted by name
+    std::vector<slot> table_; // size is power of two, empty slot has index npos
+    std::vector<std::uint64_t> seeds_; // seeds of buckets of perfect hash, empty - ordinary table
+    unsigned shift_;
+    bool frozen_;
+    mutable task<Ts...> empty_task_; // for out of range access by operator[]
 
   public:
 
     /** Creates empty tasks. */
-    tasks():subscribers_(),empty_task_() {}
+    tasks():subscribers_(),table_(),seeds_(),shift_(64),frozen_(false),empty_task_() {}
 
     /** Creates tasks by copyable constructor. \param[in] rhs tasks for copying */
     tasks(const tasks<Ts...>& rhs):tasks() { *this = rhs; }
 
     /** Creates tasks by movable constructor. \param[in] rhs tasks for moving */
-    tasks(tasks<Ts...>&& rhs):tasks() { *this = rhs; }
+    tasks(tasks<Ts...>&& rhs):tasks() { *this = std::move(rhs); }
 
     ~tasks() {}
 
     /** Adds task into container. \param[in] nm name of task \param[in] t function/method/lambda \param[in] hlp message help for task */
     void subscribe(const std::string& nm, const decltype(std::function<std::any(Ts...)>()) &t, const std::string& hlp = {}) noexcept {
-      if (!std::empty(nm) && subscribers_.find(nm) == std::end(subscribers_) && !!t) {
-        subscribers_[nm] = std::make_shared<task<Ts...>>(nm, t, hlp);
+      if (!std::empty(nm) && find(nm) == npos && !!t) { insert(std::make_shared<task<Ts...>>(nm, t, hlp)); }
+    }
+
+    /** Adds asynchronous task into container. \param[in] nm name of task \param[in] t function returning future<std::any> \param[in] hlp message help for task \see task::async() */
+    void subscribe_async(const std::string& nm, const std::function<future<std::any>(Ts...)>& t, const std::string& hlp = {}) {
+      if (!std::empty(nm) && find(nm) == npos && !!t) {
+        auto p = std::make_shared<task<Ts...>>();
+        p->name(nm);
+        p->help(hlp);
+        p->async(t);
+        insert(std::move(p));
       }
     }
 
-    /** Removes task from container. \param[in] nm name of task */
-    void unsubscribe(const std::string& nm) noexcept {
-      if (auto it = subscribers_.find(nm); it != std::end(subscribers_)) { subscribers_.erase(it); }
+    /** Adds typed task into container. \param[in] nm name of task \param[in] t function with signature S \param[in] hlp message help for task \see task::typed() */
+    template<typename S, typename F>
+    void subscribe(const std::string& nm, const F& t, const std::string& hlp = {}) {
+      if (!std::empty(nm) && find(nm) == npos) {
+        auto p = std::make_shared<task<Ts...>>();
+        p->name(nm);
+        p->help(hlp);
+        p->template typed<S>(t);
+        if (!p->empty()) { insert(std::move(p)); }
+      }
+    }
+
+    /** Sets batch handler for task, which is created if it does not exist. \param[in] nm name of task \param[in] f batch handler with signature S \param[in] hlp message help for new task \see task::batch() */
+    template<typename S, typename F>
+    void subscribe_batch(const std::string& nm, const F& f, const std::string& hlp = {}) {
+      if (std::empty(nm)) { return; }
+      if (std::size_t i = find(nm); i != npos) {
+        auto t = std::make_shared<task<Ts...>>(*subscribers_[i]);
+        t->template batch<S>(f);
+        subscribers_[i] = t;
+      } else {
+        auto p = std::make_shared<task<Ts...>>();
+        p->name(nm);
+        p->help(hlp);
+        p->template batch<S>(f);
+        if (!p->empty()) { insert(std::move(p)); }
+      }
+    }
+
+    /** \returns True if micro-batching of task was set or removed. \param[in] nm index or name of task \param[in] window time of collecting, zero - removes it \param[in] max_calls calls in batch \see task::micro_batch() */
+    template<typename S, typename T, typename Rep, typename Period>
+    bool micro_batch(const T& nm, const std::chrono::duration<Rep, Period>& window, std::size_t max_calls) {
+      if (std::size_t i = index(nm); i != npos) {
+        auto t = std::make_shared<task<Ts...>>(*subscribers_[i]);
+        if (!t->template micro_batch<S>(window, max_calls)) { return false; }
+        subscribers_[i] = t;
+        return true;
+      } else { return false; }
+    }
+
+    /** Sets single-flight mode for task. \param[in] nm index or name of task \param[in] keys types of arguments, nullptr - removes the mode \see task::flights() */
+    template<typename T>
+    void flights(const T& nm, std::shared_ptr<const any_keys> keys) {
+      if (std::size_t i = index(nm); i != npos) {
+        auto t = std::make_shared<task<Ts...>>(*subscribers_[i]);
+        t->flights(std::move(keys));
+        subscribers_[i] = t;
+      }
+    }
+
+    /** Sets cache of results for task. \param[in] nm index or name of task \param[in] c cache, nullptr - removes cache \see task::cache() */
+    template<typename T>
+    void cache(const T& nm, std::shared_ptr<result_cache> c) {
+      if (std::size_t i = index(nm); i != npos) {
+        auto t = std::make_shared<task<Ts...>>(*subscribers_[i]);
+        t->cache(std::move(c));
+        subscribers_[i] = t;
+      }
+    }
+
+    /** Sets own executor for task. \param[in] nm index or name of task \param[in] e executor \param[in] h hints for scheduling \see task::executor() */
+    template<typename T>
+    void executor(const T& nm, std::shared_ptr<iexecutor> e, const iexecutor::hints& h = {}) {
+      if (std::size_t i = index(nm); i != npos) {
+        auto t = std::make_shared<task<Ts...>>(*subscribers_[i]);
+        t->executor(std::move(e), h);
+        subscribers_[i] = t;
+      }
     }
 
+    /** Removes task from container. \param[in] nm name of task */
+    void unsubscribe(std::string_view nm) noexcept { unsubscribe(find(nm)); }
+
+    /** Removes task from container. \param[in] k key of task */
+    void unsubscribe(const task_key& k) noexcept { unsubscribe(find(k.name, k.hash)); }
+
     /** Removes task from container. \param[in] i index of task */
     void unsubscribe(std::size_t i) noexcept {
-      if (i < subscribers_.size()) {
-        for (auto it = std::begin(subscribers_); it != std::end(subscribers_); ++it) {
-          if (!i--) { subscribers_.erase(it); break; }
-        }
+      if (i < std::size(subscribers_)) {
+        subscribers_.erase(std::begin(subscribers_) + std::ptrdiff_t(i));
+        rebuild();
       }
     }
 
-    /** \returns Shared future for result of called task. \param[in] nm index or name of task \param[in] args arguments for task \see task::run(Args&&... args), operator[](const std::string& nm), operator[](std::size_t i) */
+    /** Rebuilds lookup table as perfect hash until next subscribing. \returns True if perfect hash was built. \see is_frozen() */
+    bool freeze() noexcept {
+      if (frozen_ || std::empty(subscribers_)) { return frozen_; }
+      std::size_t n = std::size(subscribers_), nbuckets = 1;
+      unsigned bits = 1;
+      while ((std::size_t(1) << bits) < n + n / 4) { ++bits; }
+      while (nbuckets * 4 < n) { nbuckets <<= 1; }
+      // buckets of tasks, the largest ones are placed first
+      std::vector<std::vector<std::size_t>> buckets(nbuckets);
+      for (std::size_t i = 0; i < n; ++i) { buckets[task_hash(subscribers_[i]->name()) & (nbuckets - 1)].push_back(i); }
+      std::vector<std::size_t> order(nbuckets);
+      for (std::size_t b = 0; b < nbuckets; ++b) { order[b] = b; }
+      std::stable_sort(std::begin(order), std::end(order), [&buckets](std::size_t a, std::size_t b) { return std::size(buckets[a]) > std::size(buckets[b]); });
+      table_.assign(std::size_t(1) << bits, slot{0, npos});
+      seeds_.assign(nbuckets, 0);
+      shift_ = 64 - bits;
+      std::vector<std::size_t> placed;
+      for (std::size_t b : order) {
+        bool ok = std::empty(buckets[b]);
+        for (std::uint64_t k = 1; !ok && k <= 4096; ++k) {
+          seeds_[b] = k * 0x9e3779b97f4a7c15ull;
+          placed.clear();
+          ok = true;
+          for (std::size_t i : buckets[b]) {
+            std::uint64_t h = task_hash(subscribers_[i]->name());
+            std::size_t j = mix(h, seeds_[b]);
+            if (table_[j].index != npos) { ok = false; break; }
+            table_[j] = slot{h, i};
+            placed.push_back(j);
+          }
+          if (!ok) { for (std::size_t j : placed) { table_[j] = slot{0, npos}; } }
+        }
+        if (!ok) { rebuild(); return false; }
+      } return (frozen_ = true);
+    }
+
+    /** \returns True if lookup table is perfect hash. \see freeze() */
+    inline bool is_frozen() const noexcept { return frozen_; }
+
+    /** \returns Future for result of called task. \param[in] nm index or name of task \param[in] args arguments for task \see task::run() */
     template<typename T, typename... Args>
-    inline std::shared_future<std::any> operator()(const T& nm, Args&&... args) {
+    inline future<std::any> operator()(const T& nm, Args&&... args) {
       return (*this)[nm](std::forward<Args>(args)...);
     }
 
@@ -83,7 +267,10 @@ namespace micro {
     inline std::size_t count() const noexcept { return std::size(subscribers_); }
 
     /** \returns True if container has task. \param[in] nm name of task */
-    inline bool has(const std::string& nm) const noexcept { return (subscribers_.find(nm) != subscribers_.end()); }
+    inline bool has(std::string_view nm) const noexcept { return (find(nm) != npos); }
+
+    /** \returns True if container has task. \param[in] k key of task */
+    inline bool has(const task_key& k) const noexcept { return (find(k.name, k.hash) != npos); }
 
     /** \returns True if container has task. \param[in] i index of task */
     inline bool has(std::size_t i) const noexcept { return (i < std::size(subscribers_)); }
@@ -91,7 +278,7 @@ namespace micro {
     /** Clears once-flag for all tasks in container \see task::clear_once(), task::is_once() */
     void clear_once() noexcept {
       for (auto it = std::begin(subscribers_); it != std::end(subscribers_); ++it) {
-        it->second->clear_once();
+        (*it)->clear_once();
       }
     }
 
@@ -99,57 +286,120 @@ namespace micro {
     inline int idle() const noexcept {
       int ret = std::numeric_limits<int>::max(), current_idle = 0;
       for (auto it = std::cbegin(subscribers_); it != std::cend(subscribers_); ++it) {
-        if ((current_idle = it->second->idle()) < ret && !(ret = current_idle)) { return ret; }
+        if ((current_idle = (*it)->idle()) < ret && !(ret = current_idle)) { return ret; }
       } return ret;
     }
 
     /** Resets all tasks in container. \see task::reset() */
     void reset() noexcept {
       for (auto it = std::begin(subscribers_); it != std::end(subscribers_); ++it) {
-        it->second->reset();
+        (*it)->reset();
       }
     }
 
     /** Copyable assignment. \param[in] rhs tasks for copying */
     tasks<Ts...>& operator=(const tasks<Ts...>& rhs) noexcept {
-      if (this != &rhs) { subscribers_ = rhs.subscribers_; }
-      return *this;
+      if (this != &rhs) {
+        subscribers_ = rhs.subscribers_;
+        table_ = rhs.table_;
+        seeds_ = rhs.seeds_;
+        shift_ = rhs.shift_;
+        frozen_ = rhs.frozen_;
+      } return *this;
     }
 
     /** Movable assignment. \param[in] rhs tasks for moving */
     tasks<Ts...>& operator=(tasks<Ts...>&& rhs) noexcept {
-      if (this != &rhs) { subscribers_ = std::move(rhs.subscribers_); }
-      return *this;
+      if (this != &rhs) {
+        subscribers_ = std::move(rhs.subscribers_);
+        table_ = std::move(rhs.table_);
+        seeds_ = std::move(rhs.seeds_);
+        shift_ = rhs.shift_;
+        frozen_ = rhs.frozen_;
+        rhs.rebuild();
+      } return *this;
     }
 
-    /** \returns Const reference to task. \param[in] nm name of task in container */
-    inline task<Ts...>& operator[](const std::string& nm) const noexcept {
-      if (auto it = subscribers_.find(nm); it != std::cend(subscribers_)) { return *it->second.get(); }
-      else { return empty_task_; }
+    /** \returns Task or nullptr, it stays alive while it is shared. \param[in] nm index, name or key of task */
+    template<typename T>
+    inline std::shared_ptr<task<Ts...>> get(const T& nm) const noexcept {
+      std::size_t i = index(nm);
+      return (i != npos) ? subscribers_[i] : nullptr;
     }
 
-    /** \returns Reference to task. \param[in] nm name of task in container */
-    inline task<Ts...>& operator[](const std::string& nm) noexcept {
-      if (auto it = subscribers_.find(nm); it != std::end(subscribers_)) { return *it->second.get(); }
-      else { return empty_task_; }
+    /** \returns Pointer to task or nullptr if it was not found, it is valid while this container is alive. \param[in] nm index, name or key of task in container */
+    template<typename T>
+    inline task<Ts...>* lookup(const T& nm) const noexcept {
+      std::size_t i = index(nm);
+      return (i != npos) ? subscribers_[i].get() : nullptr;
     }
 
+    /** \returns Const reference to task. \param[in] nm name of task in container */
+    inline task<Ts...>& operator[](std::string_view nm) const noexcept { return (*this)[find(nm)]; }
+
+    /** \returns Reference to task. \param[in] nm name of task in container */
+    inline task<Ts...>& operator[](std::string_view nm) noexcept { return (*this)[find(nm)]; }
+
+    /** \returns Const reference to task. \param[in] k key of task in container */
+    inline task<Ts...>& operator[](const task_key& k) const noexcept { return (*this)[find(k.name, k.hash)]; }
+
+    /** \returns Reference to task. \param[in] k key of task in container */
+    inline task<Ts...>& operator[](const task_key& k) noexcept { return (*this)[find(k.name, k.hash)]; }
+
     /** \returns Const reference to task. \param[in] i index of task in container */
     inline task<Ts...>& operator[](std::size_t i) const noexcept {
-      if (i < std::size(subscribers_)) {
-        for (auto it = std::cbegin(subscribers_); it != std::cend(subscribers_); ++it) {
-          if (!i--) { return *it->second.get(); }
-        }
-      } return empty_task_;
+      return (i < std::size(subscribers_)) ? *subscribers_[i] : empty_task_;
     }
 
     /** \returns Reference to task. \param[in] i index of task in container */
     inline task<Ts...>& operator[](std::size_t i) noexcept {
-      if (i < std::size(subscribers_)) {
-        for (auto it = std::begin(subscribers_); it != std::end(subscribers_); ++it) {
-          if (!i--) { return *it->second.get(); }
-        }
-      } return empty_task_;
+      return (i < std::size(subscribers_)) ? *subscribers_[i] : empty_task_;
+    }
+
+  private:
+
+    inline std::size_t index(std::string_view nm) const noexcept { return find(nm); }
+
+    inline std::size_t index(const task_key& k) const noexcept { return find(k.name, k.hash); }
+
+    inline std::size_t index(std::size_t i) const noexcept { return (i < std::size(subscribers_)) ? i : npos; }
+
+    void insert(std::shared_ptr<task<Ts...>> t) {
+      auto it = std::lower_bound(std::begin(subscribers_), std::end(subscribers_), t->name(), [](const auto& p, const std::string& n) { return p->name() < n; });
+      subscribers_.insert(it, std::move(t));
+      rebuild();
+    }
+
+    inline std::size_t mix(std::uint64_t h, std::uint64_t seed) const noexcept { return std::size_t(((h ^ seed) * 0x9e3779b97f4a7c15ull) >> shift_); }
+
+    inline std::size_t home(std::uint64_t h) const noexcept { return frozen_ ? mix(h, seeds_[h & (std::size(seeds_) - 1)]) : mix(h, 0); }
+
+    inline std::size_t find(std::string_view nm) const noexcept { return find(nm, task_hash(nm)); }
+
+    // returns index of task or npos, h is task_hash(nm)
+    std::size_t find(std::string_view nm, std::uint64_t h) const noexcept {
+      if (std::empty(table_)) { return npos; }
+      for (std::size_t i = home(h), mask = std::size(table_) - 1; table_[i].index != npos; i = (i + 1) & mask) {
+        if (table_[i].hash == h && subscribers_[table_[i].index]->name() == nm) { return table_[i].index; }
+        if (frozen_) { break; } // each task is in own home slot
+      } return npos;
+    }
+
+    // ordinary table (linear probing) with load factor not above 1/2
+    void rebuild() noexcept {
+      frozen_ = false;
+      seeds_.clear();
+      if (std::empty(subscribers_)) { table_.clear(); shift_ = 64; return; }
+      unsigned bits = 1;
+      while ((std::size_t(1) << bits) < 2 * std::size(subscribers_)) { ++bits; }
+      table_.assign(std::size_t(1) << bits, slot{0, npos});
+      shift_ = 64 - bits;
+      for (std::size_t n = 0, mask = std::size(table_) - 1; n < std::size(subscribers_); ++n) {
+        std::uint64_t h = task_hash(subscribers_[n]->name());
+        std::size_t i = home(h);
+        while (table_[i].index != npos) { i = (i + 1) & mask; }
+        table_[i] = slot{h, n};
+      }
     }
 
   };
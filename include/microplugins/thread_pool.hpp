@@ -0,0 +1,168 @@
+/** \file thread_pool.hpp */
+#ifndef THREAD_POOL_HPP_INCLUDED
+#define THREAD_POOL_HPP_INCLUDED
+
+#include "executor.hpp"
+#include "singleton.hpp"
+#include "time.hpp"
+
+#include <limits> // std::numeric_limits
+#include <vector>
+
+namespace micro {
+
+  /**
+    \class thread_pool
+    \brief Bounded work-stealing pool of threads
+    \copyright Boost Software License - Version 1.0
+
+    Each worker has own deque of jobs. Worker takes jobs from back of own deque (the latest, their data are in cache),
+    and steals jobs from front of deques of other workers (the oldest) when own deque is empty.
+    Jobs posted from a worker go into deque of that worker, other jobs are spreaded by round-robin
+    or go to worker given by hint affinity. Jobs with hint priority above 0 go into separate lane of worker,
+    which is taken in order of posting ahead of the deque, by the worker and by thieves.
+
+    Amount of queued jobs is bounded by capacity (by default jobs_per_worker per worker), when it is reached - job is executed by the calling thread.
+
+    Default pool is got by thread_pool::get(), own pools are created by std::make_shared<micro::thread_pool>(n).
+
+    \code
+    std::shared_ptr<micro::thread_pool> pool = micro::thread_pool::get();
+    micro::future<std::any> result = pool->submit([]()->std::any{ return 125 + 175; });
+    result.wait();
+    std::cout << std::any_cast<int>(result.get()) << std::endl;
+    \endcode
+  */
+  class thread_pool final : public iexecutor, public singleton<thread_pool> {
+  private:
+
+    friend class singleton<thread_pool>;
+
+    struct worker {
+      std::mutex mtx;
+      std::deque<std::function<void()>> jobs;
+      std::deque<std::function<void()>> urgent; // jobs with priority, first in first out
+    };
+
+    std::vector<std::unique_ptr<worker>> workers_;
+    std::vector<std::thread> threads_;
+    std::mutex mtx_; // for parking of idle workers
+    std::condition_variable cv_;
+    std::atomic<bool> do_work_;
+    std::atomic<std::size_t> pending_, idle_, next_;
+    std::size_t capacity_;
+
+  public:
+
+    static constexpr std::size_t jobs_per_worker = 1024; ///< capacity of pool by default, for each worker
+    static constexpr std::size_t by_workers = std::numeric_limits<std::size_t>::max(); ///< capacity of pool by amount of workers (see jobs_per_worker)
+
+    /**
+      Creates pool of threads. \param[in] n amount of workers, 0 - by std::thread::hardware_concurrency()
+      \param[in] capacity maximum queued jobs, by_workers - jobs_per_worker for each worker, 0 - unbounded
+    */
+    explicit thread_pool(std::size_t n = 0, std::size_t capacity = by_workers):iexecutor(),singleton<thread_pool>(),
+    workers_(),threads_(),mtx_(),cv_(),do_work_(true),pending_(0),idle_(0),next_(0),capacity_(capacity) {
+      if (!n && !(n = std::thread::hardware_concurrency())) { n = 2; }
+      if (capacity_ == by_workers) { capacity_ = n * jobs_per_worker; }
+      else if (!capacity_) { capacity_ = std::numeric_limits<std::size_t>::max(); }
+      for (std::size_t i = 0; i < n; ++i) { workers_.push_back(std::make_unique<worker>()); }
+      for (std::size_t i = 0; i < n; ++i) { threads_.emplace_back(&thread_pool::loop_cb, this, i); }
+    }
+
+    /** Executes queued jobs and stops workers. Pool which is destroyed by own worker (its job released the last pointer) detaches that worker. */
+    ~thread_pool() override {
+      do_work_ = false;
+      { std::unique_lock<std::mutex> lock(mtx_); }
+      cv_.notify_all();
+      for (auto& t : threads_) {
+        if (!t.joinable()) { continue; }
+        if (t.get_id() == std::this_thread::get_id()) { current() = nullptr; t.detach(); } // it returns without touching the pool, see loop_cb(std::size_t i)
+        else { t.join(); }
+      }
+    }
+
+    /** \returns Amount of workers. */
+    std::size_t size() const noexcept { return std::size(threads_); }
+
+    /** \returns Amount of workers. */
+    std::size_t concurrency() const noexcept override { return size(); }
+
+    /** \returns Maximum amount of queued jobs. */
+    std::size_t capacity() const noexcept { return capacity_; }
+
+    /** \returns Amount of queued jobs in this moment. */
+    std::size_t pending() const noexcept { return pending_; }
+
+    /** Puts job into the pool. If pool is overloaded, job will executed by the calling thread. \param[in] job function for execution \param[in] h hints for scheduling */
+    void post(std::function<void()> job, const hints& h = {}) override {
+      if (!do_work_ || pending_ >= capacity_) { job(); return; }
+      std::size_t i = (h.affinity >= 0) ? (std::size_t(h.affinity) % std::size(workers_)) :
+                      (current() == this) ? index() : (next_++ % std::size(workers_));
+      {
+        std::unique_lock<std::mutex> lock(workers_[i]->mtx);
+        if (h.priority > 0) { workers_[i]->urgent.push_back(std::move(job)); }
+        else { workers_[i]->jobs.push_back(std::move(job)); }
+        ++pending_; // it is changed with deques under their locks, so pending job is always in some deque
+      }
+      if (idle_) {
+        { std::unique_lock<std::mutex> lock(mtx_); }
+        cv_.notify_one();
+      }
+    }
+
+  private:
+
+    static thread_pool*& current() noexcept { static thread_local thread_pool* p = nullptr; return p; }
+
+    static std::size_t& index() noexcept { static thread_local std::size_t i = 0; return i; }
+
+    // takes job with priority, else job from back (owner) or from front (thief) of deque (lock of worker must be owned)
+    bool take(worker& w, bool owner, std::function<void()>& job) noexcept {
+      if (!std::empty(w.urgent)) { job = std::move(w.urgent.front()); w.urgent.pop_front(); }
+      else if (std::empty(w.jobs)) { return false; }
+      else if (owner) { job = std::move(w.jobs.back()); w.jobs.pop_back(); }
+      else { job = std::move(w.jobs.front()); w.jobs.pop_front(); }
+      --pending_;
+      return true;
+    }
+
+    bool pop(std::size_t i, std::function<void()>& job) noexcept {
+      if (std::unique_lock<std::mutex> lock(workers_[i]->mtx); take(*workers_[i], true, job)) { return true; }
+      // steal jobs of other workers, busy deques are skipped first, then they are waited for
+      for (bool blocking : {false, true}) {
+        for (std::size_t n = 1; n < std::size(workers_) && pending_; ++n) {
+          worker& w = *workers_[(i + n) % std::size(workers_)];
+          std::unique_lock<std::mutex> lock(w.mtx, std::defer_lock);
+          if (blocking) { lock.lock(); } else if (!lock.try_lock()) { continue; }
+          if (take(w, false, job)) { return true; }
+        }
+      } return false;
+    }
+
+    void loop_cb(std::size_t i) noexcept {
+      current() = this;
+      index() = i;
+      std::function<void()> job;
+      while (true) {
+        if (pending_ && pop(i, job)) {
+          job();
+          job = nullptr;
+          if (current() != this) { return; } // pool was destroyed by the job
+        } else if (!do_work_ && !pending_) {
+          break;
+        } else {
+          std::unique_lock<std::mutex> lock(mtx_);
+          ++idle_;
+          // all deques were checked under their locks, so pending job was pushed after check and it is taken by next pop()
+          cv_.wait(lock, [this]()->bool{ return (pending_ || !do_work_); });
+          --idle_;
+        }
+      }
+    }
+
+  };
+
+} // namespace micro
+
+#endif // THREAD_POOL_HPP_INCLUDED
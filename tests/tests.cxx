@@ -0,0 +1,227 @@
+#ifndef TESTS_CXX
+#define TESTS_CXX
+
+#include "plugins.hpp"
+
+#include <future>
+
+
+// tests are run by ctest from the build directory (plugins are searched there): tests <name>
+
+static int failed = 0;
+
+#define CHECK(c) do { if (!(c)) { ++failed; std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #c << std::endl; } } while (0)
+
+
+// waits for condition of retirement, which is done by thread of kernel
+template<typename F>
+static bool eventually(F&& f) {
+  for (int i = 0; i < 2000 && !f(); ++i) { micro::sleep<micro::milliseconds>(1); }
+  return f();
+}
+
+
+static std::any sum2(std::any a1, std::any a2) { return std::any_cast<int>(a1) + std::any_cast<int>(a2); }
+
+
+class local_storage final : public micro::storage<> {
+public:
+
+  local_storage():micro::storage<>(micro::make_version(1,0), "local") { subscribe<2>("sum2", sum2); }
+
+  using micro::storage<>::subscribe;
+
+  using micro::storage<>::unsubscribe;
+
+};
+
+
+// resolved tasks are invalidated by changes of executor and by unsubscribing, handle outlives its storage
+static void test_handles() {
+  auto s = std::make_unique<local_storage>();
+  s->executor(std::make_shared<micro::inline_executor>());
+  auto h = s->bind<2>("sum2");
+  CHECK(h && std::any_cast<int>(h(1, 2).get()) == 3);
+  s->subscribe<1>("other", [](std::any a) { return a; });
+  CHECK(h && std::any_cast<int>(h(2, 2).get()) == 4); // other tasks do not invalidate
+  s->executor(micro::thread_pool::get());
+  CHECK(!h && !h(1, 1).valid());
+  h = s->bind<2>("sum2");
+  CHECK(h && std::any_cast<int>(h(3, 2).get()) == 5);
+  s->unsubscribe<2>("sum2");
+  CHECK(!h && !s->bind<2>("sum2"));
+  s->subscribe<2>("sum2", sum2);
+  s->executor(std::make_shared<micro::inline_executor>());
+  // callers rebind while storage is changed
+  std::atomic<bool> stop(false);
+  std::atomic<int> wrong(0);
+  std::vector<std::thread> ts;
+  for (int i = 0; i < 4; ++i) {
+    ts.emplace_back([&s, &stop, &wrong]() {
+      auto hh = s->bind<2>("sum2");
+      while (!stop) {
+        if (auto f = hh(1, 1); f.valid()) { if (std::any_cast<int>(f.get()) != 2) { ++wrong; } }
+        else { hh = s->bind<2>("sum2"); }
+      }
+    });
+  }
+  for (int i = 0; i < 1000; ++i) {
+    if (i % 3 == 0) { s->unsubscribe<2>("sum2"); s->subscribe<2>("sum2", sum2); }
+    else if (i % 2) { s->executor(std::make_shared<micro::inline_executor>()); }
+    else { s->executor(micro::thread_pool::get()); }
+  }
+  stop = true;
+  for (auto& t : ts) { t.join(); }
+  CHECK(!wrong);
+  h = s->bind<2>("sum2");
+  s.reset();
+  CHECK(!h && !h(1, 1).valid());
+}
+
+
+static std::atomic<int> alive(0);
+
+struct snapshot {
+  int value;
+  explicit snapshot(int v):value(v) { ++alive; }
+  ~snapshot() { value = -1; --alive; }
+};
+
+// retired snapshots are deleted after their readers, writers do not wait for readers
+static void test_rcu() {
+  micro::rcu<snapshot> r(std::make_unique<snapshot>(0));
+  r.publish(std::make_unique<snapshot>(1));
+  CHECK(alive == 1);
+  {
+    auto rd = r.read();
+    r.publish(std::make_unique<snapshot>(2)); // writer inside own read-side section
+    CHECK(rd->value == 1 && alive == 2);
+  }
+  r.publish(std::make_unique<snapshot>(3));
+  CHECK(alive == 1);
+  std::atomic<int> phase(0);
+  int seen = 0;
+  std::thread t([&r, &phase, &seen]() {
+    auto rd = r.read();
+    phase = 1;
+    while (phase != 2) { std::this_thread::yield(); }
+    seen = rd->value;
+  });
+  while (phase != 1) { std::this_thread::yield(); }
+  for (int i = 4; i < 100; ++i) { r.publish(std::make_unique<snapshot>(i)); }
+  CHECK(alive >= 2);
+  phase = 2;
+  t.join();
+  CHECK(seen == 3);
+  r.publish(std::make_unique<snapshot>(100));
+  r.publish(std::make_unique<snapshot>(101));
+  CHECK(alive == 1);
+  std::atomic<bool> stop(false);
+  std::atomic<int> wrong(0);
+  std::vector<std::thread> ts;
+  for (int i = 0; i < 4; ++i) { ts.emplace_back([&r, &stop, &wrong]() { while (!stop) { if (r.read()->value < 0) { ++wrong; } } }); }
+  for (int i = 0; i < 10000; ++i) { r.publish(std::make_unique<snapshot>(i)); }
+  stop = true;
+  for (auto& x : ts) { x.join(); }
+  r.publish(std::make_unique<snapshot>(0));
+  r.publish(std::make_unique<snapshot>(1));
+  CHECK(!wrong && alive == 1);
+}
+
+
+// kernel with own pool: service of plugin and calls waiting for gate occupy its workers
+static std::shared_ptr<micro::plugins<>> kernel() {
+  auto k = micro::plugins<>::get();
+  if (!k->is_run()) { k->executor(std::make_shared<micro::thread_pool>(4)); k->negative_ttl(std::chrono::seconds(0)); k->run(); }
+  return k;
+}
+
+// unloading waits for calls in flight (by plugin and by resolved task), their users are released meanwhile
+static void test_drain() {
+  auto k = kernel();
+  std::promise<void> gate;
+  std::shared_future<void> g = gate.get_future().share();
+  auto p = k->get_plugin("tests_plugin");
+  CHECK(p);
+  if (!p) { return; }
+  CHECK(eventually([&p]() { return p->in_flight() == 1; })); // service
+  auto h = p->bind<1>("wait");
+  micro::future<std::any> f1 = p->run<1>("wait", g), f2 = h(g);
+  CHECK(p->in_flight() == 3);
+  p = nullptr;
+  CHECK(!k->unload_plugin("tests_plugin", std::chrono::milliseconds(50)));
+  CHECK(k->count_plugins() == 0);
+  CHECK(eventually([&h]() { return !h; })); // retirement invalidates resolved tasks before it waits for calls
+  CHECK(!h(g).valid());
+  std::thread opener([&gate]() { micro::sleep<micro::milliseconds>(50); gate.set_value(); });
+  p = k->get_plugin("tests_plugin"); // new loading, calls of previous one are in flight yet
+  CHECK(p && eventually([&p]() { return p->in_flight() == 1; })); // calls of previous loading are not counted
+  p = nullptr;
+  CHECK(k->unload_plugin("tests_plugin", std::chrono::seconds(10)));
+  opener.join();
+  CHECK(f1.wait_for(std::chrono::seconds(10)) == std::future_status::ready && std::any_cast<int>(f1.get()) == 1);
+  CHECK(f2.wait_for(std::chrono::seconds(10)) == std::future_status::ready && std::any_cast<int>(f2.get()) == 1);
+  for (int i = 0; i < 20; ++i) { // service, which thread has not started yet, is stopped by unloading too
+    CHECK(k->get_plugin("tests_plugin"));
+    CHECK(k->unload_plugin("tests_plugin", std::chrono::seconds(2)));
+  }
+  k->stop(); // it joins threads of kernel (services and retirements)
+  CHECK(!k->is_run());
+}
+
+// swapped plugin is replaced at once, previous version is retired by its last user
+static void test_swap() {
+  auto k = kernel();
+  auto v1 = k->get_plugin("tests_plugin");
+  CHECK(v1);
+  if (!v1) { return; }
+  auto h1 = v1->bind<2>("sum2");
+  auto v2 = k->swap_plugin("tests_plugin");
+  CHECK(v2 && v2 != v1 && k->get_plugin("tests_plugin") == v2);
+  CHECK(h1 && std::any_cast<int>(h1(1, 2).get()) == 3); // users of previous version keep it
+  CHECK(!v1->is_run() && eventually([&v2]() { return v2->is_run(); })); // service of previous version is stopped
+  v1 = nullptr;
+  CHECK(eventually([&h1]() { return !h1; }));
+  CHECK(v2 && std::any_cast<int>(v2->run<2>("sum2", 2, 2).get()) == 4);
+  v2 = nullptr;
+  k->stop();
+}
+
+// concurrent callers of the same plugin wait for one loading, missing plugin is nullptr
+static void test_loading() {
+  auto k = kernel();
+  std::vector<std::shared_ptr<micro::iplugin<>>> ps(8);
+  std::vector<micro::future<std::shared_ptr<micro::iplugin<>>>> fs(8);
+  std::vector<std::thread> ts;
+  for (std::size_t i = 0; i < std::size(ps); ++i) {
+    ts.emplace_back([&k, &ps, &fs, i]() {
+      if (i % 2) { ps[i] = k->get_plugin("tests_plugin"); }
+      else { fs[i] = k->get_plugin_async("tests_plugin"); ps[i] = fs[i].get(); }
+    });
+  }
+  for (auto& t : ts) { t.join(); }
+  CHECK(ps[0] && std::all_of(std::begin(ps), std::end(ps), [&ps](const auto& p) { return p == ps[0]; }));
+  auto f = k->get_plugin_async("tests_plugin");
+  CHECK(f.is_ready() && f.get() == ps[0]); // loaded plugin is ready at once
+  f = {};
+  CHECK(!k->get_plugin("missing_plugin") && !k->get_plugin_async("missing_plugin").get());
+  CHECK(k->count_plugins() == 1);
+  ps.clear();
+  fs.clear();
+  k->stop();
+}
+
+
+int main(int argc, char** argv) {
+  const std::map<std::string, void(*)()> tests = {{"handles", test_handles}, {"rcu", test_rcu}, {"drain", test_drain}, {"swap", test_swap}, {"loading", test_loading}};
+  if (argc != 2 || !tests.count(argv[1])) {
+    std::cerr << "usage: tests <name>, names:";
+    for (const auto& t : tests) { std::cerr << " " << t.first; }
+    std::cerr << std::endl;
+    return 2;
+  }
+  tests.at(argv[1])();
+  return failed ? 1 : 0;
+}
+
+#endif // TESTS_CXX
@@ -0,0 +1,52 @@
+#ifndef TESTS_PLUGIN_CXX
+#define TESTS_PLUGIN_CXX
+
+#include "iplugins.hpp"
+
+#include <future>
+
+
+// service works while plugin is loaded, its thread holds the plugin
+static std::any service(std::any a1) {
+  std::shared_ptr<micro::iplugin<>> self = std::any_cast<std::shared_ptr<micro::iplugin<>>>(a1);
+  while (self->is_run()) { micro::sleep<micro::milliseconds>(1); }
+  return {};
+}
+
+
+// call in flight until the test opens its gate
+static std::any wait(std::any a1) {
+  std::any_cast<std::shared_future<void>>(a1).wait();
+  return 1;
+}
+
+
+static std::any sum2(std::any a1, std::any a2) {
+  return std::any_cast<int>(a1) + std::any_cast<int>(a2);
+}
+
+
+class tests_plugin final : public micro::iplugin<>, public std::enable_shared_from_this<tests_plugin> {
+public:
+
+  tests_plugin(int v, const std::string& nm):micro::iplugin<>(v, nm),std::enable_shared_from_this<tests_plugin>() {
+    subscribe<1>("service", service);
+    subscribe<1>("wait", wait);
+    subscribe<2>("sum2", sum2);
+  }
+
+  ~tests_plugin() override {}
+
+  std::shared_ptr<micro::iplugin<>> get_shared_ptr() override {
+    return std::shared_ptr<micro::iplugin<>>(shared_from_this());
+  }
+
+};
+
+
+// each loading gets own instance, so tests tell loadings apart by pointers
+std::shared_ptr<micro::iplugin<>> import_plugin() {
+  return std::make_shared<tests_plugin>(micro::make_version(1,0), "tests_plugin");
+}
+
+#endif // TESTS_PLUGIN_CXX